@@ -151,20 +151,19 @@ BOOL applyPNGFilters(UBYTE *decompressedData, ULONG decompressedSize,
     /* Validate input */
     if (!decompressedData || !outputData || !lineBytes)
     {
-        fileLoggerAddDebugEntry("Invalid parameters for applyPNGFilters");
+        LOG_DEBUG("Invalid parameters for applyPNGFilters");
         return FALSE;
     }
 
     /* Check if the decompressed size matches what we expect */
     if (decompressedSize < expectedSize)
     {
-        sprintf(logMessage, "PNG filter processing: Expected %lu bytes, got %lu bytes",
-                expectedSize, decompressedSize);
-        fileLoggerAddDebugEntry(logMessage);
+        LOG_DEBUGF(logMessage, "PNG filter processing: Expected %lu bytes, got %lu bytes",
+                   expectedSize, decompressedSize);
         return FALSE;
     }
 
-    fileLoggerAddDebugEntry("Starting PNG filter processing");
+    LOG_TRACE("Starting PNG filter processing");
 
     /* Process each scanline */
     for (row = 0; row < height; row++)
@@ -199,8 +198,7 @@ BOOL applyPNGFilters(UBYTE *decompressedData, ULONG decompressedSize,
             break;
 
         default:
-            sprintf(logMessage, "Unknown PNG filter type: %d in row %lu", (int)filterType, (unsigned long)row);
-            fileLoggerAddDebugEntry(logMessage);
+            LOG_DEBUGF(logMessage, "Unknown PNG filter type: %d in row %lu", (int)filterType, (unsigned long)row);
             return FALSE;
         }
 
@@ -208,6 +206,103 @@ BOOL applyPNGFilters(UBYTE *decompressedData, ULONG decompressedSize,
         prevScanline = scanline;
     }
 
-    fileLoggerAddDebugEntry("PNG filter processing completed successfully");
+    LOG_TRACE("PNG filter processing completed successfully");
     return TRUE;
 }
+
+/* Unfilter a single scanline in place
+ * Every filter only reads filtered[i + 1] before writing scanline[i], so
+ * the filter functions work in place with scanline = filtered + 1 */
+BOOL unfilterPNGScanline(UBYTE *filtered, UBYTE *prevScanline, ULONG lineBytes, UBYTE bytesPerPixel)
+{
+    UBYTE *scanline = filtered + 1;
+    char logMessage[256];
+
+    switch (filtered[0])
+    {
+    case PNG_FILTER_NONE:
+        /* Already in place */
+        break;
+
+    case PNG_FILTER_SUB:
+        applySubFilter(filtered, scanline, prevScanline, lineBytes, bytesPerPixel);
+        break;
+
+    case PNG_FILTER_UP:
+        /* Without a previous scanline the data is already in place */
+        if (prevScanline)
+            applyUpFilter(filtered, scanline, prevScanline, lineBytes, bytesPerPixel);
+        break;
+
+    case PNG_FILTER_AVERAGE:
+        applyAverageFilter(filtered, scanline, prevScanline, lineBytes, bytesPerPixel);
+        break;
+
+    case PNG_FILTER_PAETH:
+        applyPaethFilter(filtered, scanline, prevScanline, lineBytes, bytesPerPixel);
+        break;
+
+    default:
+        LOG_DEBUGF(logMessage, "Unknown PNG filter type: %d", (int)filtered[0]);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Sum of the filtered bytes taken as signed values, the usual estimate of
+ * how well a filtered scanline will compress */
+static ULONG sumFilteredBytes(UBYTE *bytes, ULONG length)
+{
+    ULONG sum = 0;
+    ULONG i;
+
+    for (i = 0; i < length; i++)
+        sum += (bytes[i] < 128) ? bytes[i] : 256 - bytes[i];
+
+    return sum;
+}
+
+/* Filter a scanline for writing, trying None, Sub, Up and Paeth
+ * Each candidate is built in candidate and kept in filtered when it has
+ * the smallest sum so far; Average rarely wins and is not tried */
+UBYTE filterPNGScanline(UBYTE *scanline, UBYTE *prevScanline, ULONG lineBytes, UBYTE bytesPerPixel,
+                        UBYTE *filtered, UBYTE *candidate)
+{
+    static const UBYTE filterTypes[3] = {PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_PAETH};
+    ULONG bestSum, sum, i;
+    UBYTE t;
+
+    filtered[0] = PNG_FILTER_NONE;
+    memcpy(filtered + 1, scanline, lineBytes);
+    bestSum = sumFilteredBytes(filtered + 1, lineBytes);
+
+    for (t = 0; t < 3; t++)
+    {
+        UBYTE type = filterTypes[t];
+
+        for (i = 0; i < lineBytes; i++)
+        {
+            UBYTE left = (i >= bytesPerPixel) ? scanline[i - bytesPerPixel] : 0;
+            UBYTE up = prevScanline ? prevScanline[i] : 0;
+            UBYTE upLeft = (prevScanline && i >= bytesPerPixel) ? prevScanline[i - bytesPerPixel] : 0;
+
+            if (type == PNG_FILTER_SUB)
+                candidate[i + 1] = scanline[i] - left;
+            else if (type == PNG_FILTER_UP)
+                candidate[i + 1] = scanline[i] - up;
+            else
+                candidate[i + 1] = scanline[i] - paethPredictor(left, up, upLeft);
+        }
+
+        sum = sumFilteredBytes(candidate + 1, lineBytes);
+        if (sum < bestSum)
+        {
+            bestSum = sum;
+            candidate[0] = type;
+            memcpy(filtered, candidate, lineBytes + 1);
+        }
+    }
+
+    return filtered[0];
+}
@@ -31,6 +31,34 @@ BOOL applyPNGFilters(UBYTE *decompressedData, ULONG decompressedSize,
                      ULONG width, ULONG height, UBYTE bytesPerPixel,
                      UBYTE *outputData);
 
+/*
+ * Unfilter a single scanline in place
+ * Inputs:
+ *   - filtered: Filter type byte followed by lineBytes filtered bytes;
+ *               the unfiltered bytes replace the filtered ones at filtered + 1
+ *   - prevScanline: Previous unfiltered scanline (NULL for the first row of an image or pass)
+ *   - lineBytes: Bytes per scanline, without the filter byte
+ *   - bytesPerPixel: Number of bytes per pixel (1 for bit depths below 8)
+ * Returns:
+ *   - TRUE if successful, FALSE for an unknown filter type
+ */
+BOOL unfilterPNGScanline(UBYTE *filtered, UBYTE *prevScanline, ULONG lineBytes, UBYTE bytesPerPixel);
+
+/*
+ * Filter a single scanline for writing, choosing the filter per row
+ * Inputs:
+ *   - scanline: Unfiltered scanline
+ *   - prevScanline: Previous unfiltered scanline (NULL for the first row)
+ *   - lineBytes: Bytes per scanline, without the filter byte
+ *   - bytesPerPixel: Number of bytes per pixel
+ *   - filtered: Receives the filter type byte followed by lineBytes filtered bytes
+ *   - candidate: Scratch buffer of lineBytes + 1 bytes
+ * Returns:
+ *   - The filter type chosen
+ */
+UBYTE filterPNGScanline(UBYTE *scanline, UBYTE *prevScanline, ULONG lineBytes, UBYTE bytesPerPixel,
+                        UBYTE *filtered, UBYTE *candidate);
+
 /*
  * Individual filter processing functions
  * Each takes:
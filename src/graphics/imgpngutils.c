@@ -20,59 +20,200 @@
 #include "imgpaletteutils.h"
 #include "imgpngfilters.h"
 #include "../utils/zlibutils.h"
+#include "../utils/inflatestream.h"
+#include "../utils/deflateutils.h"
+#include "../utils/crc32utils.h"
+
+/* Adam7 pass origins and spacing as (x, y) pairs */
+static const UBYTE adam7Start[7][2] = {{0, 0}, {4, 0}, {0, 4}, {2, 0}, {0, 2}, {1, 0}, {0, 1}};
+static const UBYTE adam7Step[7][2] = {{8, 8}, {8, 8}, {4, 8}, {4, 4}, {2, 4}, {2, 2}, {1, 2}};
+
+/* No transparent pixel converted yet */
+#define PNG_NO_TRANSPARENT_PIXEL 0xFFFFFFFF
+
+/* Colour conversion state shared by every row of one image */
+typedef struct
+{
+    PNGHeader *header;
+    UBYTE *outImageData;          /* 24-bit RGB destination */
+    ImgPalette *imgPalette;       /* Receives transparency flags, may be NULL */
+    UBYTE *palette;               /* PLTE entries for indexed images */
+    ULONG numColors;
+    BOOL hasTransColor;           /* RGB or grey image has a tRNS colour */
+    UWORD transR, transG, transB; /* Grey images use transR only */
+    UBYTE greyLevels[256];        /* Grey sample to 8-bit intensity */
+    ULONG pixelsConverted;        /* Pixels converted so far, in conversion order */
+    ULONG firstTransparentPixel;  /* Conversion index of the first transparent RGBA pixel */
+    BOOL opaqueBlackPending;      /* Opaque black written before the first transparent pixel */
+} PNGRowConverter;
+
+/* Fused inflate, unfilter and convert state for one image */
+typedef struct
+{
+    InflateStream *stream;        /* The shared pngInflater */
+    PNGRowConverter converter;
+    PNGHeader *header;
+    UBYTE *rowBuffers;            /* Two scanlines of rowBufferSize bytes */
+    ULONG rowBufferSize;          /* Filter byte plus the widest row */
+    UBYTE *currentRow;            /* Scanline being inflated */
+    UBYTE *previousRow;           /* Last unfiltered scanline of this pass, NULL at its top */
+    UBYTE *unpackBuffer;          /* One byte per sample for rows that are not 8-bit */
+    UBYTE bitsPerPixel;
+    UBYTE filterBpp;              /* Filter byte distance, at least 1 */
+    UBYTE pass;                   /* Current Adam7 pass, always 0 when not interlaced */
+    UBYTE passCount;
+    ULONG passWidth;
+    ULONG passHeight;
+    ULONG passRow;                /* Row within the current pass */
+    ULONG rowBytes;               /* Packed bytes per row of the current pass */
+    BOOL finished;                /* Every row of every pass converted */
+    ULONG result;                 /* Last inflate stream result */
+} PNGRowPipeline;
+
+/* A PNG in memory: a whole file read with a single Read, or a buffer
+ * supplied by the caller. Chunks are returned as views into data, so
+ * reading them needs no allocation, copy or seek */
+typedef struct
+{
+    UBYTE *data;                  /* File contents */
+    ULONG size;                   /* Bytes in data */
+    ULONG pos;                    /* Offset of the next chunk */
+} PNGSource;
+
+/* Verify the Adler-32 of each image's zlib stream */
+static BOOL pngVerifyChecksum = TRUE;
+
+/* Verify the CRC-32 of every chunk */
+static BOOL pngVerifyCRC = FALSE;
+
+/* Inflater shared by every image load; its window and table workspace
+ * are allocated on first use and kept until freePNGDecoder */
+static InflateStream pngInflater;
+static BOOL pngInflaterReady = FALSE;
+
+/* Packed byte to samples for 1, 2 and 4-bit rows, leftmost sample first */
+static UBYTE pngUnpack1[256][8];
+static UBYTE pngUnpack2[256][4];
+static UBYTE pngUnpack4[256][2];
+static BOOL pngUnpackTablesReady = FALSE;
 
 /* Forward declarations for internal functions */
-static BOOL validatePNGSignature(FILE *file);
-static BOOL readPNGChunk(FILE *file, ULONG *chunkType, ULONG *chunkLength, UBYTE **chunkData);
+static BOOL openPNGSource(CONST_STRPTR filename, PNGSource *source);
+static void closePNGSource(PNGSource *source);
+static BOOL validatePNGSignature(PNGSource *source);
+static BOOL readPNGChunk(PNGSource *source, ULONG *chunkType, ULONG *chunkLength, UBYTE **chunkData);
+static BOOL writePNGChunk(FILE *file, ULONG chunkType, UBYTE *chunkData, ULONG chunkLength);
+static void putPNGLong(UBYTE *buffer, ULONG value);
 static BOOL decodePNGHeader(UBYTE *data, PNGHeader *header);
 static BOOL processPNGPaletteChunk(UBYTE *chunkData, ULONG chunkLength, UBYTE **palette, ULONG *paletteSize, BOOL *hasPalette);
 static BOOL processPNGTransparencyChunk(UBYTE *chunkData, ULONG chunkLength, UBYTE **transData, ULONG *transSize, BOOL *hasTrans, UBYTE colorType);
-static BOOL processPNGImageDataChunk(UBYTE *chunkData, ULONG chunkLength, UBYTE **outImageData, ULONG width, ULONG height,
-                                     ImgPalette *imgPalette, FILE *file, BOOL *foundIDAT, BOOL useTestPattern, PNGHeader *pngHeader,
-                                     UBYTE *transData, ULONG transSize, BOOL hasTrans);
+static BOOL getPNGPassGeometry(PNGHeader *pngHeader, UBYTE pass, ULONG *passWidth, ULONG *passHeight);
+static BOOL initPNGRowConverter(PNGRowConverter *converter, PNGHeader *pngHeader, UBYTE *outImageData, ImgPalette *imgPalette,
+                                UBYTE *palette, ULONG paletteSize, UBYTE *transData, ULONG transSize, BOOL hasTrans);
+static void initPNGGreyLevels(PNGRowConverter *converter, UBYTE bitDepth);
+static void convertPNGRow(PNGRowConverter *converter, UBYTE *pixels, ULONG pixelCount, ULONG y, ULONG xStart, ULONG xStep);
+static void finishPNGRowConverter(PNGRowConverter *converter);
+static void startNextPNGPass(PNGRowPipeline *pipeline);
+static void buildPNGUnpackTables(void);
+static UBYTE *unpackPNGRow(PNGRowPipeline *pipeline, UBYTE *row);
+static BOOL emitPNGRow(PNGRowPipeline *pipeline);
+static PNGRowPipeline *createPNGRowPipeline(PNGHeader *pngHeader, UBYTE *outImageData, ImgPalette *imgPalette,
+                                            UBYTE *palette, ULONG paletteSize, UBYTE *transData, ULONG transSize, BOOL hasTrans);
+static void freePNGRowPipeline(PNGRowPipeline *pipeline);
+static ULONG processPNGImageDataChunk(UBYTE *chunkData, ULONG chunkLength, PNGRowPipeline *pipeline);
 static void generateTestPattern(UBYTE **outImageData, ULONG width, ULONG height);
 static void logTestPatternColorGrid(void);
 
-/* Main PNG loading function - simplified version for 24-bit RGB PNGs */
+/* Enable or disable zlib Adler-32 verification of PNG image data */
+void setPNGChecksumVerification(BOOL verify)
+{
+    pngVerifyChecksum = verify;
+}
+
+/* Enable or disable CRC-32 verification of PNG chunks */
+void setPNGCrcVerification(BOOL verify)
+{
+    pngVerifyCRC = verify;
+}
+
+/* Release the inflate workspace kept between PNG loads */
+void freePNGDecoder(void)
+{
+    if (pngInflaterReady)
+    {
+        endInflateStream(&pngInflater);
+        pngInflaterReady = FALSE;
+    }
+}
+
+/* Main PNG loading function - reads the whole file and decodes it from memory */
 BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalette **outPalette)
 {
-    FILE *file = NULL;
-    BOOL success = FALSE;
-    PNGHeader pngHeader;
-    ULONG width = 0, height = 0;
-    ULONG numPaletteEntries = 0;
+    PNGSource source;
+    BOOL success;
     char logMessage[256];
 
     /* Input validation */
     if (!outImageData)
     {
-        fileLoggerAddDebugEntry("loadPNGToBitmapObject: outImageData is NULL");
+        LOG_DEBUG("loadPNGToBitmapObject: outImageData is NULL");
         return FALSE;
     }
 
     *outImageData = NULL;
-
     if (outPalette)
         *outPalette = NULL;
 
-    /* Open the PNG file */
-    file = fopen(filename, "rb");
-    if (!file)
+    /* Read the whole PNG file */
+    if (!openPNGSource(filename, &source))
+    {
+        LOG_DEBUGF(logMessage, "Failed to read PNG file: %s", filename);
+        return FALSE;
+    }
+
+    success = loadPNGFromMemory(source.data, source.size, outImageData, outPalette);
+
+    /* Release the file contents */
+    closePNGSource(&source);
+
+    return success;
+}
+
+/* Decode a PNG held in memory - simplified version for 24-bit RGB output */
+BOOL loadPNGFromMemory(const UBYTE *buffer, ULONG length, UBYTE **outImageData, ImgPalette **outPalette)
+{
+    PNGSource source;
+    BOOL success = FALSE;
+    PNGHeader pngHeader;
+    ULONG width = 0, height = 0;
+    char logMessage[256];
+
+    /* Input validation */
+    if (!outImageData || (!buffer && length > 0))
     {
-        sprintf(logMessage, "Failed to open PNG file: %s", filename);
-        fileLoggerAddDebugEntry(logMessage);
+        LOG_DEBUG("loadPNGFromMemory: invalid parameters");
         return FALSE;
     }
 
+    *outImageData = NULL;
+    memset(&pngHeader, 0, sizeof(PNGHeader));
+
+    if (outPalette)
+        *outPalette = NULL;
+
+    /* Chunks are views into the caller's buffer, which is only ever read */
+    source.data = (UBYTE *)buffer;
+    source.size = length;
+    source.pos = 0;
+
     /* Check PNG signature */
-    if (!validatePNGSignature(file))
+    if (!validatePNGSignature(&source))
     {
-        fileLoggerAddDebugEntry("Invalid PNG signature");
-        fclose(file);
+        LOG_DEBUG("Invalid PNG signature");
         return FALSE;
     }
 
-    fileLoggerAddDebugEntry("PNG signature validated");
+    LOG_DEBUG("PNG signature validated");
 
     /* Allocate and initialize palette if requested */
     ImgPalette *imgPalette = NULL;
@@ -81,8 +222,7 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
         imgPalette = (ImgPalette *)malloc(sizeof(ImgPalette));
         if (!imgPalette)
         {
-            fileLoggerAddDebugEntry("Failed to allocate memory for palette structure");
-            fclose(file);
+            LOG_DEBUG("Failed to allocate memory for palette structure");
             return FALSE;
         }
         initImgPalette(imgPalette);
@@ -91,89 +231,43 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
     /* Parse PNG header to get image dimensions */
     ULONG chunkType, chunkLength;
     UBYTE *chunkData = NULL;
-    UBYTE bytesPerPixel = 3; // Default to RGB (3 bytes per pixel)
-    BOOL isIndexed = FALSE;
 
-    /* Read the first chunk (should be IHDR) */
-    if (readPNGChunk(file, &chunkType, &chunkLength, &chunkData))
+    /* The first chunk must be a valid IHDR: the output buffer and the row
+     * pipeline are both sized from it, so without it there is nothing the
+     * image data could safely be decoded into */
+    if (!readPNGChunk(&source, &chunkType, &chunkLength, &chunkData) ||
+        chunkType != PNG_CHUNK_IHDR || chunkLength != 13 ||
+        !decodePNGHeader(chunkData, &pngHeader))
     {
-        if (chunkType == PNG_CHUNK_IHDR && chunkLength == 13)
-        {
-            /* Parse the IHDR chunk */
-            if (decodePNGHeader(chunkData, &pngHeader))
-            {
-                width = pngHeader.width;
-                height = pngHeader.height;
-
-                sprintf(logMessage, "PNG Header info: %lux%lu pixels, bitDepth: %u, colorType: %u",
-                        width, height, pngHeader.bitDepth, pngHeader.colorType);
-                fileLoggerAddDebugEntry(logMessage);
-
-                /* Use the actual width and height from the PNG */
-                if (width > 0 && height > 0)
-                {
-                    fileLoggerAddDebugEntry("Using actual PNG dimensions");
+        LOG_DEBUG("Missing or invalid IHDR chunk");
+        if (imgPalette)
+            freeImgPalette(imgPalette);
+        return FALSE;
+    }
 
-                    // Determine bytes per pixel based on color type
-                    switch (pngHeader.colorType)
-                    {
-                    case PNG_COLOR_TYPE_RGB:
-                        bytesPerPixel = 3; // RGB
-                        fileLoggerAddDebugEntry("PNG uses RGB color format (3 bytes per pixel)");
-                        break;
-                    case PNG_COLOR_TYPE_RGBA:
-                        bytesPerPixel = 4; // RGBA
-                        fileLoggerAddDebugEntry("PNG uses RGBA color format (4 bytes per pixel)");
-                        break;
-                    case PNG_COLOR_TYPE_PALETTE:
-                        bytesPerPixel = 1; // Indexed
-                        isIndexed = TRUE;
-                        fileLoggerAddDebugEntry("PNG uses palette color format (1 byte per pixel)");
-                        break;
-                    default:
-                        fileLoggerAddDebugEntry("Unsupported PNG color type, defaulting to RGB");
-                        bytesPerPixel = 3;
-                        break;
-                    }
-                }
-                else
-                {
-                    /* Fallback to default size if something went wrong */
-                    width = 64;
-                    height = 64;
-                    bytesPerPixel = 3;
-                    fileLoggerAddDebugEntry("Invalid dimensions, using default 64x64");
-                }
-            }
-        }
-        else
-        {
-            fileLoggerAddDebugEntry("First chunk is not IHDR or has wrong size");
-            /* Fallback to default size */
-            width = 64;
-            height = 64;
-            bytesPerPixel = 3;
-        }
+    width = pngHeader.width;
+    height = pngHeader.height;
 
-        free(chunkData);
-    }
-    else
+    /* The RGB output and the widest (64 bits per pixel) scanline must both
+     * fit in a ULONG */
+    if (width > 0x1FFFFFFUL || height > 0xFFFFFFFFUL / 3 / width)
     {
-        fileLoggerAddDebugEntry("Failed to read IHDR chunk");
-        /* Fallback to default size */
-        width = 64;
-        height = 64;
-        bytesPerPixel = 3;
+        LOG_DEBUGF(logMessage, "PNG dimensions too large: %lux%lu", width, height);
+        if (imgPalette)
+            freeImgPalette(imgPalette);
+        return FALSE;
     }
 
+    LOG_DEBUGF(logMessage, "PNG Header info: %lux%lu pixels, bitDepth: %u, colorType: %u",
+               width, height, pngHeader.bitDepth, pngHeader.colorType);
+
     /* Allocate memory for the 24-bit RGB output image */
     *outImageData = (UBYTE *)malloc(width * height * 3); // Always use 3 bytes per pixel for output
     if (!*outImageData)
     {
-        fileLoggerAddDebugEntry("Failed to allocate memory for image data");
+        LOG_DEBUG("Failed to allocate memory for image data");
         if (imgPalette)
             freeImgPalette(imgPalette);
-        fclose(file);
         return FALSE;
     }
 
@@ -181,8 +275,6 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
     memset(*outImageData, 0, width * height * 3);
 
     /* Read the PNG data and convert to RGB */
-    UBYTE *rawData = NULL;
-    ULONG rawDataSize = 0;
     UBYTE *palette = NULL;
     ULONG paletteSize = 0;
     BOOL hasPalette = FALSE;
@@ -194,12 +286,13 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
 
     /* Track if we found IDAT chunks */
     BOOL foundIDAT = FALSE;
+    BOOL imageDataFailed = FALSE;
 
-    /* Go back to right after the IHDR chunk */
-    fseek(file, 8 + 8 + chunkLength + 4, SEEK_SET);
+    /* All IDAT payloads form one zlib stream, unfiltered and converted row by row */
+    PNGRowPipeline *pipeline = NULL;
 
-    /* Read all chunks until IEND */
-    while (readPNGChunk(file, &chunkType, &chunkLength, &chunkData))
+    /* Read all chunks after IHDR until IEND */
+    while (readPNGChunk(&source, &chunkType, &chunkLength, &chunkData))
     {
         /* Process the chunk based on its type */
         switch (chunkType)
@@ -215,13 +308,23 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
             break;
 
         case PNG_CHUNK_IDAT:
-            /* Process the image data chunk */
-            processPNGImageDataChunk(chunkData, chunkLength, outImageData, width, height, imgPalette, file, &foundIDAT, FALSE, &pngHeader, transData, transSize, hasTrans);
+            /* Start the pipeline on the first IDAT chunk; PLTE and tRNS come before it */
+            if (!foundIDAT)
+            {
+                foundIDAT = TRUE;
+                pipeline = createPNGRowPipeline(&pngHeader, *outImageData, imgPalette, palette, paletteSize,
+                                                transData, transSize, hasTrans);
+            }
+
+            /* Process the image data chunk; a corrupt stream ends the load here
+             * rather than reading the rest of the file for nothing */
+            if (!pipeline || processPNGImageDataChunk(chunkData, chunkLength, pipeline) == INFLATE_STREAM_ERROR)
+                imageDataFailed = TRUE;
             break;
 
         case PNG_CHUNK_IEND:
             /* End of PNG file */
-            fileLoggerAddDebugEntry("Found IEND chunk - end of PNG file");
+            LOG_DEBUG("Found IEND chunk - end of PNG file");
             break;
 
         default:
@@ -229,10 +332,8 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
             break;
         }
 
-        free(chunkData);
-
-        /* Stop after IEND */
-        if (chunkType == PNG_CHUNK_IEND)
+        /* Stop after IEND or once the image data is known to be bad */
+        if (chunkType == PNG_CHUNK_IEND || imageDataFailed)
             break;
     }
 
@@ -265,8 +366,7 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
                     {
                         imgPalette->transparentColor = i;
                         imgPalette->hasTransparency = TRUE;
-                        sprintf(logMessage, "Setting transparent color to index %lu", i);
-                        fileLoggerAddDebugEntry(logMessage);
+                        LOG_TRACEF(logMessage, "Setting transparent color to index %lu", i);
                         break;
                     }
                 }
@@ -309,20 +409,36 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
         }
     }
 
-    /* Free transparency data if allocated */
-    if (transData)
+    /* Every row has been converted as it was inflated; fall back to the test pattern on failure */
+    if (foundIDAT)
     {
-        free(transData);
+        if (pipeline && pipeline->result == INFLATE_STREAM_DONE && pipeline->finished)
+        {
+            finishPNGRowConverter(&pipeline->converter);
+
+            LOG_DEBUGF(logMessage, "Successfully decompressed %lu bytes of PNG data", pipeline->stream->totalOut);
+            LOG_DEBUG("Successfully processed PNG image data");
+        }
+        else
+        {
+            if (pipeline && pipeline->result == INFLATE_STREAM_NEED_INPUT)
+                LOG_ERROR("PNG image data ended before the end of the zlib stream");
+            LOG_DEBUG("PNG processing failed, using test pattern as fallback");
+            generateTestPattern(outImageData, width, height);
+            logTestPatternColorGrid();
+        }
+
+        freePNGRowPipeline(pipeline);
     }
 
     if (foundIDAT)
     {
-        fileLoggerAddDebugEntry("Successfully generated RGB data from PNG");
+        LOG_DEBUG("Successfully generated RGB data from PNG");
         success = TRUE;
     }
     else
     {
-        fileLoggerAddDebugEntry("No IDAT chunks found in PNG file");
+        LOG_DEBUG("No IDAT chunks found in PNG file");
         success = FALSE;
 
         /* Free allocated memory if we failed */
@@ -340,101 +456,358 @@ BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalet
         }
     }
 
-    /* Free palette memory */
-    if (palette)
-        free(palette);
+    return success;
+}
+
+/* Read the signature, IHDR and any PLTE/tRNS before the image data with
+ * one small Read, for listing assets without decoding them */
+BOOL probePNG(CONST_STRPTR filename, PNGInfo *info)
+{
+    PNGSource source;
+    PNGHeader pngHeader;
+    BPTR file;
+    LONG bytesRead;
+    ULONG chunkType, chunkLength;
+    UBYTE *chunkData;
+    UBYTE *chunkHeader;
+    char logMessage[256];
+
+    if (!filename || !info)
+    {
+        LOG_DEBUG("probePNG: invalid parameters");
+        return FALSE;
+    }
+
+    memset(info, 0, sizeof(PNGInfo));
+
+    source.data = (UBYTE *)malloc(PNG_PROBE_READ_SIZE);
+    if (!source.data)
+    {
+        LOG_DEBUG("Failed to allocate memory for PNG probe");
+        return FALSE;
+    }
+
+    file = Open(filename, MODE_OLDFILE);
+    if (!file)
+    {
+        LOG_DEBUGF(logMessage, "Failed to open PNG file: %s", filename);
+        free(source.data);
+        return FALSE;
+    }
+
+    bytesRead = Read(file, source.data, PNG_PROBE_READ_SIZE);
+    Close(file);
+
+    source.size = (bytesRead > 0) ? bytesRead : 0;
+    source.pos = 0;
+
+    /* The first chunk must be a valid IHDR */
+    if (!validatePNGSignature(&source) ||
+        !readPNGChunk(&source, &chunkType, &chunkLength, &chunkData) ||
+        chunkType != PNG_CHUNK_IHDR || chunkLength != 13 ||
+        !decodePNGHeader(chunkData, &pngHeader))
+    {
+        LOG_DEBUGF(logMessage, "Not a valid PNG header: %s", filename);
+        closePNGSource(&source);
+        return FALSE;
+    }
+
+    info->width = pngHeader.width;
+    info->height = pngHeader.height;
+    info->bitDepth = pngHeader.bitDepth;
+    info->colorType = pngHeader.colorType;
+    info->interlaced = (pngHeader.interlaceMethod == 1);
+
+    /* Walk the chunk headers up to the first IDAT. Only lengths and types
+     * are needed, so a chunk may run past the end of what was read; the
+     * walk stops at the first chunk that is not wholly in the buffer,
+     * which keeps pos within size */
+    while (source.size - source.pos >= 8)
+    {
+        chunkHeader = source.data + source.pos;
+        chunkLength = ((ULONG)chunkHeader[0] << 24) | ((ULONG)chunkHeader[1] << 16) |
+                      ((ULONG)chunkHeader[2] << 8) | (ULONG)chunkHeader[3];
+        chunkType = ((ULONG)chunkHeader[4] << 24) | ((ULONG)chunkHeader[5] << 16) |
+                    ((ULONG)chunkHeader[6] << 8) | (ULONG)chunkHeader[7];
+
+        if (chunkType == PNG_CHUNK_IDAT || chunkType == PNG_CHUNK_IEND)
+            break;
+
+        if (chunkType == PNG_CHUNK_PLTE && chunkLength % 3 == 0 && chunkLength <= 256 * 3)
+            info->paletteSize = chunkLength / 3;
+        else if (chunkType == PNG_CHUNK_TRNS)
+            info->hasTransparency = TRUE;
+
+        if (source.size - source.pos < 12 || chunkLength > source.size - source.pos - 12)
+            break;
+        source.pos += 8 + chunkLength + 4;
+    }
+
+    LOG_DEBUGF(logMessage, "Probed %s: %lux%lu, colour type %u, %u-bit, %u palette entries",
+               filename, info->width, info->height, info->colorType, info->bitDepth, info->paletteSize);
+
+    closePNGSource(&source);
+
+    return TRUE;
+}
+
+/* Save 24-bit RGB image data (as produced by loadPNGToBitmapObject) as an
+ * 8-bit RGB PNG. Every row is filtered, the whole image is compressed in
+ * one go and written as a single IDAT chunk */
+BOOL savePNGFromRGB(CONST_STRPTR filename, UBYTE *rgbData, ULONG width, ULONG height, UBYTE level)
+{
+    const UBYTE pngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    FILE *file = NULL;
+    UBYTE header[13];
+    UBYTE *filteredData = NULL;
+    UBYTE *candidate = NULL;
+    UBYTE *compressedData = NULL;
+    ULONG compressedSize = 0;
+    ULONG lineBytes, y;
+    BOOL success = FALSE;
+    char logMessage[256];
+
+    if (!filename || !rgbData || width == 0 || height == 0)
+    {
+        LOG_DEBUG("savePNGFromRGB: invalid parameters");
+        return FALSE;
+    }
+
+    /* Filtered scanlines: one filter type byte, then the row */
+    lineBytes = width * 3;
+    filteredData = (UBYTE *)malloc((lineBytes + 1) * height);
+    candidate = (UBYTE *)malloc(lineBytes + 1);
+    if (!filteredData || !candidate)
+    {
+        LOG_DEBUG("Failed to allocate memory for filtered PNG data");
+        if (filteredData)
+            free(filteredData);
+        if (candidate)
+            free(candidate);
+        return FALSE;
+    }
+
+    for (y = 0; y < height; y++)
+    {
+        filterPNGScanline(rgbData + y * lineBytes, (y > 0) ? rgbData + (y - 1) * lineBytes : NULL,
+                          lineBytes, 3, filteredData + y * (lineBytes + 1), candidate);
+    }
+
+    success = compressZlibData(filteredData, (lineBytes + 1) * height, level, &compressedData, &compressedSize);
+    free(candidate);
+    free(filteredData);
+
+    if (!success)
+    {
+        LOG_ERROR("Failed to compress PNG image data");
+        return FALSE;
+    }
+
+    /* IHDR: 8-bit RGB, deflate, adaptive filtering, not interlaced */
+    putPNGLong(header, width);
+    putPNGLong(header + 4, height);
+    header[8] = 8;
+    header[9] = PNG_COLOR_TYPE_RGB;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_ERRORF(logMessage, "Failed to create PNG file: %s", filename);
+        free(compressedData);
+        return FALSE;
+    }
+
+    success = fwrite(pngSignature, 1, 8, file) == 8 &&
+              writePNGChunk(file, PNG_CHUNK_IHDR, header, 13) &&
+              writePNGChunk(file, PNG_CHUNK_IDAT, compressedData, compressedSize) &&
+              writePNGChunk(file, PNG_CHUNK_IEND, NULL, 0);
+
+    if (success)
+        LOG_DEBUGF(logMessage, "Saved %lux%lu PNG (%lu bytes of image data) to %s",
+                   width, height, compressedSize, filename);
+    else
+        LOG_ERRORF(logMessage, "Failed to write PNG file: %s", filename);
 
-    /* Close the file */
     fclose(file);
+    free(compressedData);
 
     return success;
 }
 
-/* Check if a file has a valid PNG signature */
-static BOOL validatePNGSignature(FILE *file)
+/* Store a 32-bit value in PNG (big-endian) byte order */
+static void putPNGLong(UBYTE *buffer, ULONG value)
+{
+    buffer[0] = (UBYTE)(value >> 24);
+    buffer[1] = (UBYTE)(value >> 16);
+    buffer[2] = (UBYTE)(value >> 8);
+    buffer[3] = (UBYTE)value;
+}
+
+/* Write one chunk: length, type, data and the CRC over type and data */
+static BOOL writePNGChunk(FILE *file, ULONG chunkType, UBYTE *chunkData, ULONG chunkLength)
 {
-    const UBYTE pngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
     UBYTE buffer[8];
+    ULONG crc;
+
+    putPNGLong(buffer, chunkLength);
+    putPNGLong(buffer + 4, chunkType);
+    crc = crc32Update(0, buffer + 4, 4);
+    if (chunkLength > 0)
+        crc = crc32Update(crc, chunkData, chunkLength);
+
+    if (fwrite(buffer, 1, 8, file) != 8)
+        return FALSE;
+    if (chunkLength > 0 && fwrite(chunkData, 1, chunkLength, file) != chunkLength)
+        return FALSE;
+
+    putPNGLong(buffer, crc);
+    return fwrite(buffer, 1, 4, file) == 4;
+}
+
+/* Read a whole PNG file into memory with one Read
+ * The size comes from seeking to the end once, so the file itself is
+ * read front to back in a single request */
+static BOOL openPNGSource(CONST_STRPTR filename, PNGSource *source)
+{
+    BPTR file;
+    LONG fileSize;
+
+    source->data = NULL;
+    source->size = 0;
+    source->pos = 0;
+
+    file = Open(filename, MODE_OLDFILE);
+    if (!file)
+        return FALSE;
+
+    Seek(file, 0, OFFSET_END);
+    fileSize = Seek(file, 0, OFFSET_BEGINNING);
+    if (fileSize <= 0)
+    {
+        LOG_DEBUG("Failed to get PNG file size");
+        Close(file);
+        return FALSE;
+    }
+
+    source->data = (UBYTE *)malloc(fileSize);
+    if (!source->data)
+    {
+        LOG_DEBUG("Failed to allocate memory for PNG file");
+        Close(file);
+        return FALSE;
+    }
+
+    if (Read(file, source->data, fileSize) != fileSize)
+    {
+        LOG_DEBUG("Failed to read PNG file");
+        free(source->data);
+        source->data = NULL;
+        Close(file);
+        return FALSE;
+    }
+
+    Close(file);
+    source->size = fileSize;
 
-    /* Go to the beginning of the file */
-    fseek(file, 0, SEEK_SET);
+    return TRUE;
+}
+
+/* Release the file contents; chunk views into it become invalid */
+static void closePNGSource(PNGSource *source)
+{
+    if (source->data)
+        free(source->data);
+
+    source->data = NULL;
+    source->size = 0;
+    source->pos = 0;
+}
+
+/* Check that the source starts with a valid PNG signature */
+static BOOL validatePNGSignature(PNGSource *source)
+{
+    const UBYTE pngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
 
-    /* Read the signature bytes */
-    if (fread(buffer, 1, 8, file) != 8)
+    if (source->size < 8)
     {
-        fileLoggerAddDebugEntry("Failed to read PNG signature bytes");
+        LOG_DEBUG("Failed to read PNG signature bytes");
         return FALSE;
     }
 
     /* Compare with the expected PNG signature */
-    if (memcmp(buffer, pngSignature, 8) != 0)
+    if (memcmp(source->data, pngSignature, 8) != 0)
     {
-        fileLoggerAddDebugEntry("Invalid PNG signature");
+        LOG_DEBUG("Invalid PNG signature");
         return FALSE;
     }
 
+    source->pos = 8;
+
     return TRUE;
 }
 
-/* Read a PNG chunk from a file */
-static BOOL readPNGChunk(FILE *file, ULONG *chunkType, ULONG *chunkLength, UBYTE **chunkData)
+/* Read the next PNG chunk from the source
+ * chunkData points into the source buffer (NULL for an empty chunk) and
+ * stays valid until closePNGSource */
+static BOOL readPNGChunk(PNGSource *source, ULONG *chunkType, ULONG *chunkLength, UBYTE **chunkData)
 {
-    UBYTE buffer[8];
-    char chunkName[5];
+    UBYTE *header;
+
+    *chunkData = NULL;
 
-    /* Read the chunk length and type (8 bytes total) */
-    if (fread(buffer, 1, 8, file) != 8)
+    /* Chunk length and type (8 bytes total) */
+    if (source->size - source->pos < 8)
     {
-        fileLoggerAddDebugEntry("Failed to read PNG chunk header");
+        LOG_DEBUG("Failed to read PNG chunk header");
         return FALSE;
     }
 
+    header = source->data + source->pos;
+
     /* Parse the chunk length (big endian) */
-    *chunkLength = ((ULONG)buffer[0] << 24) | ((ULONG)buffer[1] << 16) |
-                   ((ULONG)buffer[2] << 8) | (ULONG)buffer[3];
+    *chunkLength = ((ULONG)header[0] << 24) | ((ULONG)header[1] << 16) |
+                   ((ULONG)header[2] << 8) | (ULONG)header[3];
 
     /* Parse the chunk type */
-    *chunkType = ((ULONG)buffer[4] << 24) | ((ULONG)buffer[5] << 16) |
-                 ((ULONG)buffer[6] << 8) | (ULONG)buffer[7];
-
-    /* For logging, create a readable chunk name */
-    chunkName[0] = buffer[4];
-    chunkName[1] = buffer[5];
-    chunkName[2] = buffer[6];
-    chunkName[3] = buffer[7];
-    chunkName[4] = '\0';
-
-    /* Log the chunk information */
-    // char logMessage[256];
-    // sprintf(logMessage, "Found PNG chunk: %s, length: %lu bytes", chunkName, *chunkLength);
-    // fileLoggerAddDebugEntry(logMessage);
-
-    /* Allocate memory for the chunk data (if there is any) */
+    *chunkType = ((ULONG)header[4] << 24) | ((ULONG)header[5] << 16) |
+                 ((ULONG)header[6] << 8) | (ULONG)header[7];
+
+    /* Data and CRC must lie inside the file; compared this way round so a
+     * huge length cannot wrap the sum */
+    if (*chunkLength > source->size - source->pos - 8 ||
+        source->size - source->pos - 8 - *chunkLength < 4)
+    {
+        LOG_DEBUG("Failed to read PNG chunk data");
+        return FALSE;
+    }
+
     if (*chunkLength > 0)
+        *chunkData = header + 8;
+
+    /* Check the CRC (4 bytes) over the type and data, or skip it */
+    if (pngVerifyCRC)
     {
-        *chunkData = (UBYTE *)malloc(*chunkLength);
-        if (!*chunkData)
-        {
-            fileLoggerAddDebugEntry("Failed to allocate memory for PNG chunk data");
-            return FALSE;
-        }
+        UBYTE *crcBytes = header + 8 + *chunkLength;
+        ULONG storedCRC, crc;
+
+        storedCRC = ((ULONG)crcBytes[0] << 24) | ((ULONG)crcBytes[1] << 16) |
+                    ((ULONG)crcBytes[2] << 8) | (ULONG)crcBytes[3];
+
+        crc = crc32Update(0, header + 4, 4 + *chunkLength);
 
-        /* Read the chunk data */
-        if (fread(*chunkData, 1, *chunkLength, file) != *chunkLength)
+        if (crc != storedCRC)
         {
-            fileLoggerAddDebugEntry("Failed to read PNG chunk data");
-            free(*chunkData);
+            char logMessage[256];
+            LOG_DEBUGF(logMessage, "CRC mismatch in PNG chunk %.4s: stored 0x%08lx, calculated 0x%08lx", (char *)header + 4, storedCRC, crc);
             *chunkData = NULL;
             return FALSE;
         }
     }
-    else
-    {
-        *chunkData = NULL;
-    }
 
-    /* Skip the CRC (4 bytes) */
-    fseek(file, 4, SEEK_CUR);
+    source->pos += 8 + *chunkLength + 4;
 
     return TRUE;
 }
@@ -460,14 +833,13 @@ static BOOL decodePNGHeader(UBYTE *data, PNGHeader *header)
 
     /* Log the header information */
     char logMessage[256];
-    sprintf(logMessage, "PNG Header: %lu x %lu pixels, %u-bit, color type %u",
-            header->width, header->height, header->bitDepth, header->colorType);
-    fileLoggerAddDebugEntry(logMessage);
+    LOG_DEBUGF(logMessage, "PNG Header: %lu x %lu pixels, %u-bit, color type %u",
+               header->width, header->height, header->bitDepth, header->colorType);
 
     /* Validate the header */
     if (header->width <= 0 || header->height <= 0)
     {
-        fileLoggerAddDebugEntry("Invalid PNG dimensions");
+        LOG_DEBUG("Invalid PNG dimensions");
         return FALSE;
     }
 
@@ -506,29 +878,34 @@ static BOOL decodePNGHeader(UBYTE *data, PNGHeader *header)
 
     if (!supported)
     {
-        sprintf(logMessage, "Unsupported PNG color type %u with bit depth %u",
-                header->colorType, header->bitDepth);
-        fileLoggerAddDebugEntry(logMessage);
+        LOG_DEBUGF(logMessage, "Unsupported PNG color type %u with bit depth %u",
+                   header->colorType, header->bitDepth);
         return FALSE;
     }
 
     /* Check compression, filter, and interlace methods */
     if (header->compressionMethod != 0)
     {
-        fileLoggerAddDebugEntry("Unsupported PNG compression method");
+        LOG_DEBUG("Unsupported PNG compression method");
         return FALSE;
     }
 
     if (header->filterMethod != 0)
     {
-        fileLoggerAddDebugEntry("Unsupported PNG filter method");
+        LOG_DEBUG("Unsupported PNG filter method");
+        return FALSE;
+    }
+
+    /* Interlaced images are decoded pass by pass */
+    if (header->interlaceMethod > 1)
+    {
+        LOG_DEBUG("Unsupported PNG interlace method");
         return FALSE;
     }
 
-    /* Warning for interlaced images - we don't fully support them */
-    if (header->interlaceMethod != 0)
+    if (header->interlaceMethod == 1)
     {
-        fileLoggerAddDebugEntry("Warning: Interlaced PNG may not display correctly");
+        LOG_DEBUG("PNG uses Adam7 interlacing");
     }
 
     return TRUE;
@@ -544,35 +921,25 @@ static BOOL processPNGPaletteChunk(UBYTE *chunkData, ULONG chunkLength, UBYTE **
     /* Check if we already have a palette */
     if (*hasPalette)
     {
-        fileLoggerAddDebugEntry("Multiple PLTE chunks found, using only the first one");
+        LOG_DEBUG("Multiple PLTE chunks found, using only the first one");
         return FALSE;
     }
 
     /* Check that the palette size is valid (must be a multiple of 3) */
     if (chunkLength % 3 != 0)
     {
-        fileLoggerAddDebugEntry("Invalid palette length, not a multiple of 3");
-        return FALSE;
-    }
-
-    /* Allocate memory for the palette */
-    *palette = (UBYTE *)malloc(chunkLength);
-    if (!*palette)
-    {
-        fileLoggerAddDebugEntry("Failed to allocate memory for palette");
+        LOG_DEBUG("Invalid palette length, not a multiple of 3");
         return FALSE;
     }
 
-    /* Copy the palette data */
-    memcpy(*palette, chunkData, chunkLength);
+    /* The palette is used in place in the source buffer */
+    *palette = chunkData;
     *paletteSize = chunkLength;
     *hasPalette = TRUE;
 
     /* Log information about the palette */
-    ULONG numColors = chunkLength / 3;
     char logMessage[256];
-    sprintf(logMessage, "Palette: %lu colors", numColors);
-    fileLoggerAddDebugEntry(logMessage);
+    LOG_DEBUGF(logMessage, "Palette: %lu colors", chunkLength / 3);
 
     return TRUE;
 }
@@ -587,29 +954,20 @@ static BOOL processPNGTransparencyChunk(UBYTE *chunkData, ULONG chunkLength, UBY
     /* Check if we already have transparency data */
     if (*hasTrans)
     {
-        fileLoggerAddDebugEntry("Multiple tRNS chunks found, using only the first one");
+        LOG_DEBUG("Multiple tRNS chunks found, using only the first one");
         return FALSE;
     }
 
     /* Process transparency based on color type */
-    fileLoggerAddDebugEntry("Processing tRNS chunk (transparency data)");
-
-    /* Allocate memory for transparency data */
-    *transData = (UBYTE *)malloc(chunkLength);
-    if (!*transData)
-    {
-        fileLoggerAddDebugEntry("Failed to allocate memory for transparency data");
-        return FALSE;
-    }
+    LOG_DEBUG("Processing tRNS chunk (transparency data)");
 
-    /* Copy transparency data */
-    memcpy(*transData, chunkData, chunkLength);
+    /* The transparency data is used in place in the source buffer */
+    *transData = chunkData;
     *transSize = chunkLength;
     *hasTrans = TRUE;
 
     char logMessage[256];
-    sprintf(logMessage, "Transparency data: %lu bytes for color type %u", chunkLength, colorType);
-    fileLoggerAddDebugEntry(logMessage);
+    LOG_DEBUGF(logMessage, "Transparency data: %lu bytes for color type %u", chunkLength, colorType);
 
     return TRUE;
 }
@@ -618,7 +976,7 @@ static BOOL processPNGTransparencyChunk(UBYTE *chunkData, ULONG chunkLength, UBY
 static void generateTestPattern(UBYTE **outImageData, ULONG width, ULONG height)
 {
     /* Simple test pattern of colorful blocks */
-    fileLoggerAddDebugEntry("Generating test pattern of colored blocks");
+    LOG_DEBUG("Generating test pattern of colored blocks");
 
     /* Array of colors for the test pattern (R,G,B triplets) */
     const UBYTE colors[16][3] = {
@@ -681,360 +1039,745 @@ static void generateTestPattern(UBYTE **outImageData, ULONG width, ULONG height)
 static void logTestPatternColorGrid(void)
 {
     /* Log a grid showing the color arrangement in the test pattern */
-    fileLoggerAddDebugEntry("Test Pattern Color Grid Layout (4x4):");
-    fileLoggerAddDebugEntry("+---------+---------+---------+---------+");
-    fileLoggerAddDebugEntry("| Red     | Green   | Blue    | Yellow  |");
-    fileLoggerAddDebugEntry("+---------+---------+---------+---------+");
-    fileLoggerAddDebugEntry("| Orange  | Purple  | Cyan    | Magenta |");
-    fileLoggerAddDebugEntry("+---------+---------+---------+---------+");
-    fileLoggerAddDebugEntry("| Brown   | Pink    | Gray    | Lime    |");
-    fileLoggerAddDebugEntry("+---------+---------+---------+---------+");
-    fileLoggerAddDebugEntry("| Teal    | Gold    | White   | Black   |");
-    fileLoggerAddDebugEntry("+---------+---------+---------+---------+");
+    LOG_DEBUG("Test Pattern Color Grid Layout (4x4):");
+    LOG_DEBUG("+---------+---------+---------+---------+");
+    LOG_DEBUG("| Red     | Green   | Blue    | Yellow  |");
+    LOG_DEBUG("+---------+---------+---------+---------+");
+    LOG_DEBUG("| Orange  | Purple  | Cyan    | Magenta |");
+    LOG_DEBUG("+---------+---------+---------+---------+");
+    LOG_DEBUG("| Brown   | Pink    | Gray    | Lime    |");
+    LOG_DEBUG("+---------+---------+---------+---------+");
+    LOG_DEBUG("| Teal    | Gold    | White   | Black   |");
+    LOG_DEBUG("+---------+---------+---------+---------+");
 
     /* Also log a compact version with abbreviated color names */
-    fileLoggerAddDebugEntry("Compact color grid with abbreviated names:");
-    fileLoggerAddDebugEntry("+------+------+------+------+");
-    fileLoggerAddDebugEntry("| Red  | Grn  | Blu  | Yel  |");
-    fileLoggerAddDebugEntry("+------+------+------+------+");
-    fileLoggerAddDebugEntry("| Org  | Pur  | Cyn  | Mag  |");
-    fileLoggerAddDebugEntry("+------+------+------+------+");
-    fileLoggerAddDebugEntry("| Brn  | Pnk  | Gry  | Lim  |");
-    fileLoggerAddDebugEntry("+------+------+------+------+");
-    fileLoggerAddDebugEntry("| Teal | Gold | Wht  | Blk  |");
-    fileLoggerAddDebugEntry("+------+------+------+------+");
+    LOG_DEBUG("Compact color grid with abbreviated names:");
+    LOG_DEBUG("+------+------+------+------+");
+    LOG_DEBUG("| Red  | Grn  | Blu  | Yel  |");
+    LOG_DEBUG("+------+------+------+------+");
+    LOG_DEBUG("| Org  | Pur  | Cyn  | Mag  |");
+    LOG_DEBUG("+------+------+------+------+");
+    LOG_DEBUG("| Brn  | Pnk  | Gry  | Lim  |");
+    LOG_DEBUG("+------+------+------+------+");
+    LOG_DEBUG("| Teal | Gold | Wht  | Blk  |");
+    LOG_DEBUG("+------+------+------+------+");
 }
 
-/* Process a PNG IDAT (image data) chunk */
-static BOOL processPNGImageDataChunk(UBYTE *chunkData, ULONG chunkLength, UBYTE **outImageData, ULONG width, ULONG height,
-                                     ImgPalette *imgPalette, FILE *file, BOOL *foundIDAT, BOOL useTestPattern, PNGHeader *pngHeader,
-                                     UBYTE *transData, ULONG transSize, BOOL hasTrans)
+/* Geometry of pass number 'pass' (always 0 for non-interlaced images)
+ * Returns FALSE when the pass holds no pixels for this image size */
+static BOOL getPNGPassGeometry(PNGHeader *pngHeader, UBYTE pass, ULONG *passWidth, ULONG *passHeight)
 {
-    char logMessage[256];
+    if (pngHeader->interlaceMethod == 0)
+    {
+        *passWidth = pngHeader->width;
+        *passHeight = pngHeader->height;
+        return TRUE;
+    }
 
-    /* Validate parameters */
-    if (!chunkData || !outImageData || !foundIDAT || width <= 0 || height <= 0 || !pngHeader)
+    if (pngHeader->width <= adam7Start[pass][0] || pngHeader->height <= adam7Start[pass][1])
         return FALSE;
 
-    /* Set the found flag so we know we encountered an IDAT chunk */
-    *foundIDAT = TRUE;
+    *passWidth = (pngHeader->width - adam7Start[pass][0] + adam7Step[pass][0] - 1) / adam7Step[pass][0];
+    *passHeight = (pngHeader->height - adam7Start[pass][1] + adam7Step[pass][1] - 1) / adam7Step[pass][1];
+    return TRUE;
+}
+
+/* Fill the grey level table for a bit depth
+ * 1, 2 and 4-bit samples are scaled to the full 0-255 range by repeating
+ * their bits; 8-bit and down-converted 16-bit samples map to themselves */
+static void initPNGGreyLevels(PNGRowConverter *converter, UBYTE bitDepth)
+{
+    ULONG sample;
+    ULONG scale;
 
-    /* Make sure we have memory allocated for the 24-bit RGB output image */
-    if (*outImageData == NULL)
+    switch (bitDepth)
     {
-        *outImageData = (UBYTE *)malloc(width * height * 3);
-        if (!*outImageData)
-        {
-            fileLoggerAddDebugEntry("Failed to allocate memory for image data");
-            if (imgPalette)
-                freeImgPalette(imgPalette);
-            if (file)
-                fclose(file);
-            return FALSE;
-        }
+    case 1:
+        scale = 0xFF;
+        break;
+
+    case 2:
+        scale = 0x55;
+        break;
+
+    case 4:
+        scale = 0x11;
+        break;
+
+    default:
+        scale = 1;
+        break;
     }
 
-    if (useTestPattern)
-    {
-        /* In test pattern mode, generate a color test pattern instead of
-           decompressing actual PNG data */
-        fileLoggerAddDebugEntry("Using test pattern mode for PNG rendering");
-        generateTestPattern(outImageData, width, height);
+    for (sample = 0; sample < 256; sample++)
+        converter->greyLevels[sample] = (UBYTE)(sample * scale);
+}
 
-        /* Log the color grid layout */
-        logTestPatternColorGrid();
+/* Set up colour conversion for an image
+ * Returns FALSE for colour types and bit depths the converter cannot handle */
+static BOOL initPNGRowConverter(PNGRowConverter *converter, PNGHeader *pngHeader, UBYTE *outImageData, ImgPalette *imgPalette,
+                                UBYTE *palette, ULONG paletteSize, UBYTE *transData, ULONG transSize, BOOL hasTrans)
+{
+    char logMessage[256];
 
-        fileLoggerAddDebugEntry("Generated test pattern as fallback for PNG data");
+    memset(converter, 0, sizeof(PNGRowConverter));
+    converter->header = pngHeader;
+    converter->outImageData = outImageData;
+    converter->imgPalette = imgPalette;
+    converter->palette = palette;
+    converter->numColors = paletteSize / 3;
+    converter->firstTransparentPixel = PNG_NO_TRANSPARENT_PIXEL;
+
+    /* Log transparency info if available */
+    if (hasTrans && transData)
+    {
+        LOG_DEBUG("Using transparency information from tRNS chunk");
     }
-    else
+
+    switch (pngHeader->colorType)
     {
-        /* In normal mode, try to decompress and process the actual PNG data */
-        fileLoggerAddDebugEntry("Found IDAT chunk - attempting to process actual PNG data");
+    case PNG_COLOR_TYPE_RGB:
+        /* tRNS for RGB defines a single transparent color (R,G,B) */
+        if (hasTrans && transData && transSize >= 6)
+        {
+            converter->hasTransColor = TRUE;
+            converter->transR = (transData[0] << 8) | transData[1];
+            converter->transG = (transData[2] << 8) | transData[3];
+            converter->transB = (transData[4] << 8) | transData[5];
 
-        /* Step 1: Decompress the zlib-compressed data */
-        UBYTE *decompressedData = NULL;
-        ULONG decompressedSize = 0;
+            LOG_DEBUGF(logMessage, "Transparent RGB color: (%u,%u,%u)", converter->transR, converter->transG, converter->transB);
+
+            /* 16-bit rows are down-converted before conversion, so only
+             * the high bytes of the colour can be compared */
+            if (pngHeader->bitDepth == 16)
+            {
+                converter->transR >>= 8;
+                converter->transG >>= 8;
+                converter->transB >>= 8;
+            }
+        }
+        return TRUE;
 
-        if (decompressZlibData(chunkData, chunkLength, &decompressedData, &decompressedSize))
+    case PNG_COLOR_TYPE_GRAYSCALE:
+        /* tRNS for greyscale defines a single transparent grey sample */
+        if (hasTrans && transData && transSize >= 2)
         {
-            /* Step 2: Apply PNG filters and convert to RGB */
-            sprintf(logMessage, "Successfully decompressed %lu bytes of PNG data", decompressedSize);
-            fileLoggerAddDebugEntry(logMessage);
+            converter->hasTransColor = TRUE;
+            converter->transR = (transData[0] << 8) | transData[1];
 
-            /* Get the bytes per pixel based on color type */
-            UBYTE bytesPerPixel = 0;
-            BOOL success = FALSE;
+            LOG_DEBUGF(logMessage, "Transparent grey level: %u", converter->transR);
 
-            /* Determine bytes per pixel for filtering based on color type */
-            switch (pngHeader->colorType)
-            {
-            case PNG_COLOR_TYPE_GRAYSCALE:
-                bytesPerPixel = (pngHeader->bitDepth + 7) / 8; /* Round up to nearest byte */
-                break;
+            if (pngHeader->bitDepth == 16)
+                converter->transR >>= 8;
+        }
+        initPNGGreyLevels(converter, pngHeader->bitDepth);
+        return TRUE;
 
-            case PNG_COLOR_TYPE_RGB:
-                bytesPerPixel = 3 * pngHeader->bitDepth / 8;
-                break;
+    case PNG_COLOR_TYPE_GRAYSCALE_ALPHA:
+        /* Same alpha handling as RGBA */
+        LOG_DEBUG("Processing greyscale data with alpha channel");
 
-            case PNG_COLOR_TYPE_PALETTE:
-                bytesPerPixel = 1; /* Indexed color - always 1 byte */
-                break;
+        if (imgPalette)
+        {
+            imgPalette->hasTransparency = FALSE;
+        }
+        initPNGGreyLevels(converter, pngHeader->bitDepth);
+        return TRUE;
 
-            case PNG_COLOR_TYPE_GRAYSCALE_ALPHA:
-                bytesPerPixel = 2 * pngHeader->bitDepth / 8;
-                break;
+    case PNG_COLOR_TYPE_RGBA:
+        /* For RGBA, use alpha channel for transparency */
+        LOG_DEBUG("Processing RGBA data with alpha channel");
 
-            case PNG_COLOR_TYPE_RGBA:
-                bytesPerPixel = 4 * pngHeader->bitDepth / 8;
-                break;
+        if (imgPalette)
+        {
+            imgPalette->hasTransparency = FALSE; // Start with no transparency
+        }
+        return TRUE;
 
-            default:
-                bytesPerPixel = 0;
-                break;
-            }
+    case PNG_COLOR_TYPE_PALETTE:
+        /* For indexed color, use the PLTE entries */
+        if (!palette || converter->numColors == 0)
+        {
+            LOG_DEBUG("No palette available for indexed PNG");
+            return FALSE;
+        }
+        return TRUE;
+
+    default:
+        /* decodePNGHeader rejects any other colour type */
+        LOG_DEBUG("Unsupported PNG color type for conversion");
+        return FALSE;
+    }
+}
+
+/* Convert one unfiltered row of a pass into the RGB output
+ * Pixel i of the row lands at column xStart + i * xStep of output row y */
+static void convertPNGRow(PNGRowConverter *converter, UBYTE *pixels, ULONG pixelCount, ULONG y, ULONG xStart, ULONG xStep)
+{
+    ULONG width = converter->header->width;
+    UBYTE *out = converter->outImageData + (y * width + xStart) * 3;
+    ULONG outStep = xStep * 3;
+    UBYTE *greyLevels = converter->greyLevels;
+    ULONG i;
 
-            /* Check if we have a valid bytes per pixel value */
-            if (bytesPerPixel > 0)
+    switch (converter->header->colorType)
+    {
+    case PNG_COLOR_TYPE_GRAYSCALE:
+        if (converter->hasTransColor)
+        {
+            for (i = 0; i < pixelCount; i++, out += outStep)
             {
-                /* Allocate a buffer for the unfiltered data */
-                UBYTE *unfilteredData = (UBYTE *)malloc(width * height * bytesPerPixel);
-                if (unfilteredData)
+                if (pixels[i] == converter->transR)
                 {
-                    /* Apply PNG filters */
-                    if (applyPNGFilters(decompressedData, decompressedSize, width, height, bytesPerPixel, unfilteredData))
+                    /* Transparent grey becomes the black marker */
+                    out[0] = 0;
+                    out[1] = 0;
+                    out[2] = 0;
+
+                    if (converter->imgPalette)
                     {
-                        /* Convert unfiltered data to RGB format for output */
-                        fileLoggerAddDebugEntry("Successfully applied PNG filters");
-
-                        /* Log transparency info if available */
-                        if (hasTrans && transData)
-                        {
-                            fileLoggerAddDebugEntry("Using transparency information from tRNS chunk");
-                        }
-
-                        /* Convert to RGB format based on color type */
-                        switch (pngHeader->colorType)
-                        {
-                        case PNG_COLOR_TYPE_RGB:
-                            /* For RGB PNGs with transparency, check for single color transparency */
-                            if (hasTrans && transData && transSize >= 6)
-                            {
-                                /* tRNS for RGB defines a single transparent color (R,G,B) */
-                                UWORD transR = (transData[0] << 8) | transData[1];
-                                UWORD transG = (transData[2] << 8) | transData[3];
-                                UWORD transB = (transData[4] << 8) | transData[5];
-
-                                sprintf(logMessage, "Transparent RGB color: (%u,%u,%u)", transR, transG, transB);
-                                fileLoggerAddDebugEntry(logMessage);
-
-                                /* Compare each pixel and make transparent pixels black */
-                                for (ULONG i = 0; i < width * height; i++)
-                                {
-                                    UBYTE r = unfilteredData[i * 3];
-                                    UBYTE g = unfilteredData[i * 3 + 1];
-                                    UBYTE b = unfilteredData[i * 3 + 2];
-
-                                    /* Check if this pixel matches the transparent color */
-                                    if (r == (transR & 0xFF) && g == (transG & 0xFF) && b == (transB & 0xFF))
-                                    {
-                                        /* Make transparent pixels completely black as a marker */
-                                        (*outImageData)[i * 3] = 0;     /* R */
-                                        (*outImageData)[i * 3 + 1] = 0; /* G */
-                                        (*outImageData)[i * 3 + 2] = 0; /* B */
-
-                                        /* If we have a palette and it supports transparency */
-                                        if (imgPalette)
-                                        {
-                                            imgPalette->hasTransparency = TRUE;
-                                            imgPalette->transparentColor = 0; /* Using black as transparent */
-                                        }
-                                    }
-                                    else
-                                    {
-                                        /* Copy non-transparent pixels directly */
-                                        (*outImageData)[i * 3] = r;     /* R */
-                                        (*outImageData)[i * 3 + 1] = g; /* G */
-                                        (*outImageData)[i * 3 + 2] = b; /* B */
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                /* No transparency, direct copy for RGB data */
-                                memcpy(*outImageData, unfilteredData, width * height * 3);
-                            }
-                            success = TRUE;
-                            fileLoggerAddDebugEntry("Converted PNG RGB data to output format");
-                            break;
-
-                        case PNG_COLOR_TYPE_RGBA:
-                            /* For RGBA, use alpha channel for transparency */
-                            fileLoggerAddDebugEntry("Processing RGBA data with alpha channel");
-
-                            /* If we have a palette, we'll need to mark the transparent color */
-                            if (imgPalette)
-                            {
-                                imgPalette->hasTransparency = FALSE; // Start with no transparency
-                            }
-
-                            // First pass: check if we have any transparent pixels
-                            BOOL hasTransPixels = FALSE;
-                            for (ULONG i = 0; i < width * height && !hasTransPixels; i++)
-                            {
-                                UBYTE a = unfilteredData[i * 4 + 3];
-                                if (a < 128) // If pixel is mostly transparent
-                                {
-                                    hasTransPixels = TRUE;
-                                }
-                            }
-
-                            // Only set hasTransparency if we actually found transparent pixels
-                            if (hasTransPixels && imgPalette)
-                            {
-                                imgPalette->hasTransparency = TRUE;
-                                imgPalette->transparentColor = 0; // Using black as the marker
-                                fileLoggerAddDebugEntry("Found transparent pixels in RGBA image");
-                            }
-                            else
-                            {
-                                fileLoggerAddDebugEntry("No transparent pixels found in RGBA image");
-                            }
-
-                            for (ULONG i = 0; i < width * height; i++)
-                            {
-                                UBYTE r = unfilteredData[i * 4];
-                                UBYTE g = unfilteredData[i * 4 + 1];
-                                UBYTE b = unfilteredData[i * 4 + 2];
-                                UBYTE a = unfilteredData[i * 4 + 3];
-
-                                if (a < 128) /* If pixel is mostly transparent */
-                                {
-                                    // For transparent pixels, we'll set them to black (0,0,0)
-                                    // This is our marker for transparency
-                                    (*outImageData)[i * 3] = 0;     /* R */
-                                    (*outImageData)[i * 3 + 1] = 0; /* G */
-                                    (*outImageData)[i * 3 + 2] = 0; /* B */
-                                }
-                                else
-                                {
-                                    // For non-transparent pixels, copy the RGB values
-                                    // If the pixel is black (0,0,0) but not transparent, we'll adjust
-                                    // it slightly so it's not confused with transparent black
-                                    if (r == 0 && g == 0 && b == 0 && imgPalette && imgPalette->hasTransparency)
-                                    {
-                                        // If this is a legitimate black pixel and we have transparency
-                                        // Adjust to near-black to distinguish from transparent black
-                                        (*outImageData)[i * 3] = 1;     /* R - slight adjustment */
-                                        (*outImageData)[i * 3 + 1] = 1; /* G - slight adjustment */
-                                        (*outImageData)[i * 3 + 2] = 1; /* B - slight adjustment */
-                                    }
-                                    else
-                                    {
-                                        // For all other non-transparent colors, use the original values
-                                        (*outImageData)[i * 3] = r;     /* R */
-                                        (*outImageData)[i * 3 + 1] = g; /* G */
-                                        (*outImageData)[i * 3 + 2] = b; /* B */
-                                    }
-                                }
-                            }
-                            success = TRUE;
-                            fileLoggerAddDebugEntry("Converted PNG RGBA data to RGB output format with transparency");
-                            break;
-
-                        case PNG_COLOR_TYPE_PALETTE:
-                            /* For indexed color, use palette entries */
-                            if (imgPalette && imgPalette->colorRegs)
-                            {
-                                /* If we have transparency data for the palette */
-                                if (hasTrans && transData && transSize > 0)
-                                {
-                                    /* Set the first fully transparent color */
-                                    for (ULONG t = 0; t < transSize; t++)
-                                    {
-                                        if (transData[t] == 0) /* Fully transparent */
-                                        {
-                                            imgPalette->transparentColor = t;
-                                            imgPalette->hasTransparency = TRUE;
-                                            sprintf(logMessage, "Palette transparency: Index %lu is fully transparent", t);
-                                            fileLoggerAddDebugEntry(logMessage);
-                                            break;
-                                        }
-                                    }
-                                }
-
-                                /* Convert indexed data to RGB using the palette */
-                                for (ULONG i = 0; i < width * height; i++)
-                                {
-                                    UBYTE index = unfilteredData[i];
-                                    if (index < imgPalette->numColors)
-                                    {
-                                        /* Get color from palette */
-                                        (*outImageData)[i * 3] = imgPalette->colorRegs[index * 3];         /* R */
-                                        (*outImageData)[i * 3 + 1] = imgPalette->colorRegs[index * 3 + 1]; /* G */
-                                        (*outImageData)[i * 3 + 2] = imgPalette->colorRegs[index * 3 + 2]; /* B */
-                                    }
-                                    else
-                                    {
-                                        /* Invalid index, use black */
-                                        (*outImageData)[i * 3] = 0;     /* R */
-                                        (*outImageData)[i * 3 + 1] = 0; /* G */
-                                        (*outImageData)[i * 3 + 2] = 0; /* B */
-                                    }
-                                }
-                                success = TRUE;
-                                fileLoggerAddDebugEntry("Converted indexed PNG data to RGB using palette");
-                            }
-                            else
-                            {
-                                fileLoggerAddDebugEntry("No palette available for indexed PNG");
-                            }
-                            break;
-
-                        default:
-                            /* Other color types not yet implemented */
-                            fileLoggerAddDebugEntry("Unsupported PNG color type for conversion");
-                            break;
-                        }
+                        converter->imgPalette->hasTransparency = TRUE;
+                        converter->imgPalette->transparentColor = 0;
                     }
-                    else
+                }
+                else
+                {
+                    out[0] = out[1] = out[2] = greyLevels[pixels[i]];
+                }
+            }
+        }
+        else
+        {
+            for (i = 0; i < pixelCount; i++, out += outStep)
+                out[0] = out[1] = out[2] = greyLevels[pixels[i]];
+        }
+        break;
+
+    case PNG_COLOR_TYPE_GRAYSCALE_ALPHA:
+        for (i = 0; i < pixelCount; i++, pixels += 2, out += outStep)
+        {
+            UBYTE grey = greyLevels[pixels[0]];
+
+            if (pixels[1] < 128)
+            {
+                /* Mostly transparent pixels become the black marker */
+                out[0] = 0;
+                out[1] = 0;
+                out[2] = 0;
+
+                if (converter->firstTransparentPixel == PNG_NO_TRANSPARENT_PIXEL)
+                {
+                    converter->firstTransparentPixel = converter->pixelsConverted + i;
+                    if (converter->imgPalette)
                     {
-                        fileLoggerAddDebugEntry("PNG filter processing failed");
+                        converter->imgPalette->hasTransparency = TRUE;
+                        converter->imgPalette->transparentColor = 0;
                     }
+                }
+            }
+            else if (grey == 0 && converter->imgPalette)
+            {
+                /* Opaque black is kept distinct from the marker, as for RGBA */
+                if (converter->firstTransparentPixel != PNG_NO_TRANSPARENT_PIXEL)
+                {
+                    out[0] = 1;
+                    out[1] = 1;
+                    out[2] = 1;
+                }
+                else
+                {
+                    out[0] = 0;
+                    out[1] = 0;
+                    out[2] = 0;
+                    converter->opaqueBlackPending = TRUE;
+                }
+            }
+            else
+            {
+                out[0] = out[1] = out[2] = grey;
+            }
+        }
+        break;
+
+    case PNG_COLOR_TYPE_RGB:
+        for (i = 0; i < pixelCount; i++, pixels += 3, out += outStep)
+        {
+            UBYTE r = pixels[0];
+            UBYTE g = pixels[1];
+            UBYTE b = pixels[2];
+
+            /* Check if this pixel matches the transparent color */
+            if (converter->hasTransColor && r == (converter->transR & 0xFF) &&
+                g == (converter->transG & 0xFF) && b == (converter->transB & 0xFF))
+            {
+                /* Make transparent pixels completely black as a marker */
+                out[0] = 0;
+                out[1] = 0;
+                out[2] = 0;
+
+                /* If we have a palette and it supports transparency */
+                if (converter->imgPalette)
+                {
+                    converter->imgPalette->hasTransparency = TRUE;
+                    converter->imgPalette->transparentColor = 0; /* Using black as transparent */
+                }
+            }
+            else
+            {
+                out[0] = r;
+                out[1] = g;
+                out[2] = b;
+            }
+        }
+        break;
+
+    case PNG_COLOR_TYPE_RGBA:
+        for (i = 0; i < pixelCount; i++, pixels += 4, out += outStep)
+        {
+            UBYTE r = pixels[0];
+            UBYTE g = pixels[1];
+            UBYTE b = pixels[2];
+
+            if (pixels[3] < 128) /* If pixel is mostly transparent */
+            {
+                // Transparent pixels become black (0,0,0), our marker for transparency
+                out[0] = 0;
+                out[1] = 0;
+                out[2] = 0;
 
-                    /* Free unfiltered data */
-                    free(unfilteredData);
+                if (converter->firstTransparentPixel == PNG_NO_TRANSPARENT_PIXEL)
+                {
+                    converter->firstTransparentPixel = converter->pixelsConverted + i;
+                    if (converter->imgPalette)
+                    {
+                        converter->imgPalette->hasTransparency = TRUE;
+                        converter->imgPalette->transparentColor = 0; // Using black as the marker
+                    }
+                }
+            }
+            else if (r == 0 && g == 0 && b == 0 && converter->imgPalette)
+            {
+                // A legitimate black pixel in an image with transparency is adjusted
+                // to near-black so it's not confused with transparent black. Black
+                // pixels seen before the first transparent one are fixed up later
+                if (converter->firstTransparentPixel != PNG_NO_TRANSPARENT_PIXEL)
+                {
+                    out[0] = 1;
+                    out[1] = 1;
+                    out[2] = 1;
                 }
                 else
                 {
-                    fileLoggerAddDebugEntry("Failed to allocate memory for unfiltered data");
+                    out[0] = 0;
+                    out[1] = 0;
+                    out[2] = 0;
+                    converter->opaqueBlackPending = TRUE;
                 }
             }
             else
             {
-                fileLoggerAddDebugEntry("Invalid bytes per pixel value for PNG format");
+                out[0] = r;
+                out[1] = g;
+                out[2] = b;
+            }
+        }
+        break;
+
+    case PNG_COLOR_TYPE_PALETTE:
+        for (i = 0; i < pixelCount; i++, out += outStep)
+        {
+            UBYTE index = pixels[i];
+            if (index < converter->numColors)
+            {
+                /* Get color from palette */
+                out[0] = converter->palette[index * 3];
+                out[1] = converter->palette[index * 3 + 1];
+                out[2] = converter->palette[index * 3 + 2];
+            }
+            else
+            {
+                /* Invalid index, use black */
+                out[0] = 0;
+                out[1] = 0;
+                out[2] = 0;
             }
+        }
+        break;
+    }
+
+    converter->pixelsConverted += pixelCount;
+}
+
+/* Finish conversion once every row is in place
+ * For RGBA and greyscale+alpha images that turned out to have transparent pixels, opaque black
+ * pixels converted before the first transparent one are moved to near-black.
+ * Every black pixel converted before that point is opaque, so the rows are
+ * replayed in conversion order up to it */
+static void finishPNGRowConverter(PNGRowConverter *converter)
+{
+    PNGHeader *pngHeader = converter->header;
+    ULONG remaining = converter->firstTransparentPixel;
+    ULONG passWidth, passHeight;
+    ULONG x, y;
+    UBYTE pass, passCount;
+    UBYTE *out;
+
+    if ((pngHeader->colorType != PNG_COLOR_TYPE_RGBA && pngHeader->colorType != PNG_COLOR_TYPE_GRAYSCALE_ALPHA) ||
+        !converter->imgPalette)
+        return;
+
+    if (converter->firstTransparentPixel == PNG_NO_TRANSPARENT_PIXEL)
+    {
+        LOG_DEBUG("No transparent pixels found in alpha image");
+        return;
+    }
+
+    LOG_DEBUG("Found transparent pixels in alpha image");
+
+    if (!converter->opaqueBlackPending)
+        return;
+
+    passCount = pngHeader->interlaceMethod ? 7 : 1;
+    for (pass = 0; pass < passCount && remaining > 0; pass++)
+    {
+        ULONG xStart = pngHeader->interlaceMethod ? adam7Start[pass][0] : 0;
+        ULONG yStart = pngHeader->interlaceMethod ? adam7Start[pass][1] : 0;
+        ULONG xStep = pngHeader->interlaceMethod ? adam7Step[pass][0] : 1;
+        ULONG yStep = pngHeader->interlaceMethod ? adam7Step[pass][1] : 1;
 
-            /* Free decompressed data */
-            free(decompressedData);
+        if (!getPNGPassGeometry(pngHeader, pass, &passWidth, &passHeight))
+            continue;
 
-            /* If we successfully processed the PNG, we're done */
-            if (success)
+        for (y = 0; y < passHeight && remaining > 0; y++)
+        {
+            out = converter->outImageData + ((yStart + y * yStep) * pngHeader->width + xStart) * 3;
+            for (x = 0; x < passWidth && remaining > 0; x++, remaining--, out += xStep * 3)
             {
-                fileLoggerAddDebugEntry("Successfully processed PNG image data");
-                return TRUE;
+                if (out[0] == 0 && out[1] == 0 && out[2] == 0)
+                {
+                    out[0] = 1;
+                    out[1] = 1;
+                    out[2] = 1;
+                }
             }
+        }
+    }
+}
 
-            /* Fall back to test pattern if processing failed */
-            fileLoggerAddDebugEntry("PNG processing failed, using test pattern as fallback");
-            generateTestPattern(outImageData, width, height);
+/* Advance the pipeline to the next pass that holds pixels
+ * Points the inflate output at the first row of that pass, or marks the
+ * pipeline finished once every pass is done */
+static void startNextPNGPass(PNGRowPipeline *pipeline)
+{
+    while (pipeline->pass < pipeline->passCount)
+    {
+        if (getPNGPassGeometry(pipeline->header, pipeline->pass, &pipeline->passWidth, &pipeline->passHeight))
+        {
+            pipeline->rowBytes = (pipeline->passWidth * pipeline->bitsPerPixel + 7) / 8;
+            pipeline->passRow = 0;
+            pipeline->previousRow = NULL;
+            setInflateStreamOutput(pipeline->stream, pipeline->currentRow, pipeline->rowBytes + 1);
+            return;
         }
-        else
+        pipeline->pass++;
+    }
+
+    /* Any further image data is an error */
+    pipeline->finished = TRUE;
+    setInflateStreamOutput(pipeline->stream, pipeline->currentRow, 0);
+}
+
+/* Fill the sub-byte unpack tables */
+static void buildPNGUnpackTables(void)
+{
+    ULONG value, i;
+
+    for (value = 0; value < 256; value++)
+    {
+        for (i = 0; i < 8; i++)
+            pngUnpack1[value][i] = (value >> (7 - i)) & 0x01;
+        for (i = 0; i < 4; i++)
+            pngUnpack2[value][i] = (value >> (6 - i * 2)) & 0x03;
+        pngUnpack4[value][0] = value >> 4;
+        pngUnpack4[value][1] = value & 0x0F;
+    }
+
+    pngUnpackTablesReady = TRUE;
+}
+
+/* Expand an unfiltered row that is not 8-bit into one byte per sample
+ * 1, 2 and 4-bit samples keep their raw values (palette indices or grey
+ * levels); 16-bit samples keep their high byte. The row itself is left
+ * untouched because it is still needed to unfilter the next one */
+static UBYTE *unpackPNGRow(PNGRowPipeline *pipeline, UBYTE *row)
+{
+    UBYTE *out = pipeline->unpackBuffer;
+    UBYTE *end = row + pipeline->rowBytes;
+    const UBYTE *samples;
+
+    switch (pipeline->header->bitDepth)
+    {
+    case 1:
+        for (; row < end; row++, out += 8)
         {
-            /* Decompression failed, fall back to test pattern */
-            fileLoggerAddDebugEntry("PNG decompression failed, using test pattern instead");
-            generateTestPattern(outImageData, width, height);
+            samples = pngUnpack1[*row];
+            out[0] = samples[0];
+            out[1] = samples[1];
+            out[2] = samples[2];
+            out[3] = samples[3];
+            out[4] = samples[4];
+            out[5] = samples[5];
+            out[6] = samples[6];
+            out[7] = samples[7];
+        }
+        break;
+
+    case 2:
+        for (; row < end; row++, out += 4)
+        {
+            samples = pngUnpack2[*row];
+            out[0] = samples[0];
+            out[1] = samples[1];
+            out[2] = samples[2];
+            out[3] = samples[3];
+        }
+        break;
+
+    case 4:
+        for (; row < end; row++, out += 2)
+        {
+            samples = pngUnpack4[*row];
+            out[0] = samples[0];
+            out[1] = samples[1];
         }
+        break;
+
+    case 16:
+        for (; row < end; row += 2)
+            *out++ = row[0];
+        break;
+    }
+
+    return pipeline->unpackBuffer;
+}
+
+/* Unfilter and convert the row that has just been inflated */
+static BOOL emitPNGRow(PNGRowPipeline *pipeline)
+{
+    PNGHeader *pngHeader = pipeline->header;
+    UBYTE *finishedRow = pipeline->currentRow;
+    UBYTE *pixels = finishedRow + 1;
+    ULONG xStart = 0, xStep = 1, y = pipeline->passRow;
+
+    if (!unfilterPNGScanline(finishedRow, pipeline->previousRow ? pipeline->previousRow + 1 : NULL,
+                             pipeline->rowBytes, pipeline->filterBpp))
+    {
+        LOG_DEBUG("PNG filter processing failed");
+        return FALSE;
+    }
+
+    if (pngHeader->interlaceMethod)
+    {
+        xStart = adam7Start[pipeline->pass][0];
+        xStep = adam7Step[pipeline->pass][0];
+        y = adam7Start[pipeline->pass][1] + pipeline->passRow * adam7Step[pipeline->pass][1];
+    }
+
+    if (pipeline->unpackBuffer)
+        pixels = unpackPNGRow(pipeline, pixels);
+
+    convertPNGRow(&pipeline->converter, pixels, pipeline->passWidth, y, xStart, xStep);
+
+    /* The finished row becomes the previous row; inflate into the other buffer */
+    pipeline->currentRow = (finishedRow == pipeline->rowBuffers) ? pipeline->rowBuffers + pipeline->rowBufferSize
+                                                                : pipeline->rowBuffers;
+    pipeline->previousRow = finishedRow;
+
+    if (++pipeline->passRow < pipeline->passHeight)
+    {
+        setInflateStreamOutput(pipeline->stream, pipeline->currentRow, pipeline->rowBytes + 1);
+    }
+    else
+    {
+        pipeline->pass++;
+        startNextPNGPass(pipeline);
     }
 
     return TRUE;
 }
+
+/* Create the inflate, unfilter and convert pipeline for an image
+ * Only two scanline buffers are allocated, the inflater is reused; each
+ * row is converted into outImageData as soon as it is inflated */
+static PNGRowPipeline *createPNGRowPipeline(PNGHeader *pngHeader, UBYTE *outImageData, ImgPalette *imgPalette,
+                                            UBYTE *palette, ULONG paletteSize, UBYTE *transData, ULONG transSize, BOOL hasTrans)
+{
+    PNGRowPipeline *pipeline;
+    ULONG channels;
+
+    switch (pngHeader->colorType)
+    {
+    case PNG_COLOR_TYPE_RGB:
+        channels = 3;
+        break;
+
+    case PNG_COLOR_TYPE_GRAYSCALE_ALPHA:
+        channels = 2;
+        break;
+
+    case PNG_COLOR_TYPE_RGBA:
+        channels = 4;
+        break;
+
+    default: /* Grayscale and palette */
+        channels = 1;
+        break;
+    }
+
+    pipeline = (PNGRowPipeline *)malloc(sizeof(PNGRowPipeline));
+    if (!pipeline)
+    {
+        LOG_DEBUG("Failed to allocate memory for PNG row pipeline");
+        return NULL;
+    }
+
+    memset(pipeline, 0, sizeof(PNGRowPipeline));
+    pipeline->header = pngHeader;
+    pipeline->bitsPerPixel = channels * pngHeader->bitDepth;
+    pipeline->filterBpp = (pipeline->bitsPerPixel + 7) / 8;
+    pipeline->passCount = pngHeader->interlaceMethod ? 7 : 1;
+    pipeline->result = INFLATE_STREAM_NEED_INPUT;
+
+    if (!initPNGRowConverter(&pipeline->converter, pngHeader, outImageData, imgPalette,
+                             palette, paletteSize, transData, transSize, hasTrans))
+    {
+        free(pipeline);
+        return NULL;
+    }
+
+    /* The first pass of an interlaced image is never wider than the full row */
+    pipeline->rowBufferSize = (pngHeader->width * pipeline->bitsPerPixel + 7) / 8 + 1;
+    pipeline->rowBuffers = (UBYTE *)malloc(pipeline->rowBufferSize * 2);
+    if (!pipeline->rowBuffers)
+    {
+        LOG_DEBUG("Failed to allocate memory for PNG scanlines");
+        free(pipeline);
+        return NULL;
+    }
+
+    /* Rows that are not 8-bit are converted from a byte-per-sample copy.
+     * A packed row unpacks to at most 7 samples past the row width */
+    if (pngHeader->bitDepth != 8)
+    {
+        pipeline->unpackBuffer = (UBYTE *)malloc(pngHeader->width * channels + 8);
+        if (!pipeline->unpackBuffer)
+        {
+            LOG_DEBUG("Failed to allocate memory for PNG unpack buffer");
+            free(pipeline->rowBuffers);
+            free(pipeline);
+            return NULL;
+        }
+
+        if (pngHeader->bitDepth < 8 && !pngUnpackTablesReady)
+            buildPNGUnpackTables();
+    }
+
+    if (pngInflaterReady)
+    {
+        resetInflateStream(&pngInflater, INFLATE_FORMAT_ZLIB);
+    }
+    else if (initInflateStream(&pngInflater, INFLATE_FORMAT_ZLIB))
+    {
+        pngInflaterReady = TRUE;
+    }
+    else
+    {
+        free(pipeline->unpackBuffer);
+        free(pipeline->rowBuffers);
+        free(pipeline);
+        return NULL;
+    }
+
+    pipeline->stream = &pngInflater;
+    setInflateStreamChecksum(pipeline->stream, pngVerifyChecksum);
+
+    pipeline->currentRow = pipeline->rowBuffers;
+    startNextPNGPass(pipeline);
+
+    return pipeline;
+}
+
+/* Release the pipeline and its buffers */
+static void freePNGRowPipeline(PNGRowPipeline *pipeline)
+{
+    if (!pipeline)
+        return;
+
+    free(pipeline->unpackBuffer);
+    free(pipeline->rowBuffers);
+    free(pipeline);
+}
+
+/* Process a PNG IDAT (image data) chunk
+ * Feeds the chunk payload to the image's inflate stream, converting every
+ * row it completes. Chunks arriving after the stream ended or failed are ignored */
+static ULONG processPNGImageDataChunk(UBYTE *chunkData, ULONG chunkLength, PNGRowPipeline *pipeline)
+{
+    char logMessage[256];
+    ULONG result;
+    ULONG bitOffset;
+    UBYTE error;
+
+    /* Only a stream still waiting for input can take more data */
+    if (pipeline->result != INFLATE_STREAM_NEED_INPUT)
+    {
+        if (pipeline->result == INFLATE_STREAM_DONE)
+            LOG_DEBUG("Ignoring IDAT data after end of zlib stream");
+        return pipeline->result;
+    }
+
+    if (!chunkData || chunkLength == 0)
+        return pipeline->result;
+
+    setInflateStreamInput(pipeline->stream, chunkData, chunkLength);
+
+    for (;;)
+    {
+        result = inflateStreamProcess(pipeline->stream);
+        if (result == INFLATE_STREAM_ERROR)
+        {
+            error = getInflateStreamError(pipeline->stream, &bitOffset);
+            LOG_ERRORF(logMessage, "Failed to inflate PNG image data: %s at bit %lu of the zlib stream",
+                       getInflateErrorName(error), bitOffset);
+            break;
+        }
+
+        /* A full row buffer means a whole scanline is ready */
+        if (!pipeline->finished && pipeline->stream->availOut == 0)
+        {
+            if (!emitPNGRow(pipeline))
+            {
+                result = INFLATE_STREAM_ERROR;
+                break;
+            }
+
+            if (result == INFLATE_STREAM_OUTPUT_FULL)
+                continue;
+        }
+
+        if (result == INFLATE_STREAM_OUTPUT_FULL)
+        {
+            LOG_DEBUG("PNG image data is larger than the image dimensions allow");
+            result = INFLATE_STREAM_ERROR;
+        }
+        break;
+    }
+
+    if (result == INFLATE_STREAM_NEED_INPUT)
+    {
+        LOG_TRACEF(logMessage, "Inflated IDAT chunk of %lu bytes, %lu bytes decoded so far", chunkLength, pipeline->stream->totalOut);
+    }
+
+    pipeline->result = result;
+    return result;
+}
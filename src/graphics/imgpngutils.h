@@ -37,7 +37,48 @@ typedef struct
     UBYTE interlaceMethod;
 } PNGHeader;
 
+/* Image properties reported by probePNG */
+typedef struct
+{
+    ULONG width;
+    ULONG height;
+    UBYTE bitDepth;
+    UBYTE colorType;
+    BOOL interlaced;      /* Adam7 interlacing */
+    UWORD paletteSize;    /* PLTE entries, 0 when there is no palette */
+    BOOL hasTransparency; /* tRNS chunk present */
+} PNGInfo;
+
+/* Bytes probePNG reads from the start of a file: signature, IHDR, a full
+ * 256-entry PLTE and room for the small chunks that usually precede it */
+#define PNG_PROBE_READ_SIZE 1024
+
+/* Enable or disable zlib Adler-32 verification of PNG image data (on by default)
+ * Skipping it saves a little time on trusted assets bundled with the editor */
+void setPNGChecksumVerification(BOOL verify);
+
+/* Enable or disable CRC-32 verification of every PNG chunk (off by default)
+ * Each chunk is checked as it is read, so corrupted files fail early */
+void setPNGCrcVerification(BOOL verify);
+
+/* Release the decoder workspace kept between loads (call once at shutdown) */
+void freePNGDecoder(void);
+
 /* Load PNG image with palette information */
 BOOL loadPNGToBitmapObject(CONST_STRPTR filename, UBYTE **outImageData, ImgPalette **outPalette);
 
+/* Read only the header of a PNG file, without decoding any image data
+ * PLTE and tRNS are reported when they appear within the first
+ * PNG_PROBE_READ_SIZE bytes, before the first IDAT */
+BOOL probePNG(CONST_STRPTR filename, PNGInfo *info);
+
+/* Decode a PNG image held in memory, e.g. from an archive or level file
+ * The buffer is only read and may be released as soon as this returns */
+BOOL loadPNGFromMemory(const UBYTE *buffer, ULONG length, UBYTE **outImageData, ImgPalette **outPalette);
+
+/* Save 24-bit RGB image data as an 8-bit RGB PNG
+ * level is DEFLATE_LEVEL_NONE to DEFLATE_LEVEL_BEST, or DEFLATE_LEVEL_RLE
+ * for quick interactive saves; high levels for packed assets */
+BOOL savePNGFromRGB(CONST_STRPTR filename, UBYTE *rgbData, ULONG width, ULONG height, UBYTE level);
+
 #endif /* IMGPNGUTILS_H */
@@ -0,0 +1,18 @@
+/*
+ * CRC-32 utilities for AmigaOS 3.1
+ * Used for validating PNG chunks
+ */
+
+#ifndef CRC32UTILS_H
+#define CRC32UTILS_H
+
+#include <exec/types.h>
+
+/* Update a running CRC-32 (ISO 3309, as used by PNG and gzip) with more data
+ * Start from 0 for a new CRC; the pre and post inversion is handled here */
+ULONG crc32Update(ULONG crc, UBYTE *data, ULONG length);
+
+/* Calculate the CRC-32 of a buffer */
+ULONG calculateCRC32(UBYTE *data, ULONG length);
+
+#endif /* CRC32UTILS_H */
@@ -0,0 +1,993 @@
+/*
+ * DEFLATE/zlib compression for AmigaOS 3.1
+ * Used for saving PNG images and compressed editor data
+ *
+ * The whole input is in memory, so the match finder indexes it directly:
+ * head[] holds the latest position for each 3-byte hash and prev[] the
+ * distance back to the previous position with the same hash, giving one
+ * hash chain per hash value inside the 32 KB window. Levels 1-3 take the
+ * first match found (greedy); levels 4-9 hold a match back one byte to
+ * see whether the next position starts a longer one (lazy), as zlib does.
+ *
+ * Symbols are collected into blocks of DEFLATE_BLOCK_SYMBOLS. Each block
+ * is emitted with whichever of dynamic Huffman, fixed Huffman or stored
+ * coding is smallest for it.
+ *
+ * DEFLATE_LEVEL_RLE skips the match finder altogether and only codes
+ * repeats of the previous byte, straight to fixed Huffman blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+#include "deflateutils.h"
+#include "huffmanUtils.h"
+#include "zlibutils.h"
+#include "filelogger.h"
+
+/* Matches of length 3 this far back rarely pay for their distance bits */
+#define DEFLATE_TOO_FAR 4096
+
+/* Longest stored block */
+#define DEFLATE_STORED_MAX 65535
+
+/* Code length limits for the three Huffman codes of a dynamic block */
+#define DEFLATE_MAX_CODE_BITS 15
+#define DEFLATE_MAX_CODELEN_BITS 7
+
+/* Code length alphabet repeat codes */
+#define CODELEN_REPEAT_PREVIOUS 16 /* Previous length 3-6 times */
+#define CODELEN_REPEAT_ZERO 17     /* Zero 3-10 times */
+#define CODELEN_REPEAT_ZERO_LONG 18 /* Zero 11-138 times */
+
+/* Per-level match finder settings, after zlib's configuration table */
+typedef struct DeflateConfig
+{
+    UWORD goodLength; /* Quarter the chain search once a match this long is held */
+    UWORD maxLazy;    /* Greedy: longest match whose strings are hashed; lazy: don't look past this */
+    UWORD niceLength; /* Stop searching once a match this long is found */
+    UWORD maxChain;   /* Hash chain entries searched per position */
+    BOOL lazy;        /* Lazy rather than greedy matching */
+} DeflateConfig;
+
+static const DeflateConfig deflateConfigs[10] = {
+    {0, 0, 0, 0, FALSE},        /* 0: stored blocks only */
+    {4, 4, 8, 4, FALSE},        /* 1 */
+    {4, 5, 16, 8, FALSE},       /* 2 */
+    {4, 6, 32, 32, FALSE},      /* 3 */
+    {4, 4, 16, 16, TRUE},       /* 4 */
+    {8, 16, 32, 32, TRUE},      /* 5 */
+    {8, 16, 128, 128, TRUE},    /* 6 */
+    {8, 32, 128, 256, TRUE},    /* 7 */
+    {32, 128, 258, 1024, TRUE}, /* 8 */
+    {32, 258, 258, 4096, TRUE}  /* 9 */
+};
+
+/* LSB-first bit writer over the caller's output buffer */
+typedef struct DeflateOutput
+{
+    UBYTE *buffer;
+    ULONG size;
+    ULONG pos;
+    ULONG bitBuf;   /* Pending bits, next bit in the LSB */
+    UBYTE bitCount; /* Number of pending bits */
+    BOOL overflow;  /* Output did not fit */
+} DeflateOutput;
+
+/* One Huffman code: lengths plus the bit-reversed codes to write */
+typedef struct DeflateCode
+{
+    UBYTE lengths[FIXED_LITERAL_CODES];
+    UWORD codes[FIXED_LITERAL_CODES];
+} DeflateCode;
+
+/* Compressor state, allocated once per call so the 68k stack stays small */
+typedef struct DeflateState
+{
+    UBYTE *data;
+    ULONG size;
+    const DeflateConfig *config;
+    DeflateOutput *out;
+
+    ULONG head[DEFLATE_HASH_SIZE];   /* Latest position + 1 per hash, 0 for none */
+    UWORD prev[DEFLATE_WINDOW_SIZE]; /* Distance to the previous position with the same hash, 0 for none */
+
+    UWORD symbolLitLen[DEFLATE_BLOCK_SYMBOLS]; /* Literal byte, or match length */
+    UWORD symbolDist[DEFLATE_BLOCK_SYMBOLS];   /* Match distance, 0 for a literal */
+    ULONG symbolCount;
+    ULONG blockStart; /* Input covered by the pending symbols */
+    ULONG blockEnd;
+
+    ULONG literalFreq[MAX_LITERAL_CODES];
+    ULONG distanceFreq[MAX_DISTANCE_CODES];
+    ULONG codeLengthFreq[MAX_CODE_LENGTHS];
+    DeflateCode literalCode;
+    DeflateCode distanceCode;
+    DeflateCode codeLengthCode;
+
+    /* Run-length coded code lengths of a dynamic block header */
+    UBYTE codeLengthSymbols[MAX_LITERAL_CODES + MAX_DISTANCE_CODES];
+    UBYTE codeLengthExtra[MAX_LITERAL_CODES + MAX_DISTANCE_CODES];
+    ULONG codeLengthSymbolCount;
+
+    /* Scratch for building a code: frequencies sorted with their symbols */
+    ULONG sortFreq[FIXED_LITERAL_CODES];
+    UWORD sortSymbol[FIXED_LITERAL_CODES];
+} DeflateState;
+
+/* Length (3-258) to length code index, and distance to distance code */
+static UBYTE lengthCodeTable[DEFLATE_MAX_MATCH + 1];
+static UBYTE distanceCodeTable[512]; /* Distances 1-256 directly, then by 128 */
+static DeflateCode fixedLiteralCode;
+static DeflateCode fixedDistanceCode;
+static BOOL deflateTablesReady = FALSE;
+
+static void assignDeflateCodes(DeflateCode *code, ULONG numCodes);
+
+/* Build the length and distance code lookup tables and the fixed codes on first use */
+static void buildDeflateTables(void)
+{
+    const UWORD *lengthBase = getLengthBase();
+    const UWORD *distanceBase = getDistanceBase();
+    ULONG code, value;
+
+    code = 0;
+    for (value = DEFLATE_MIN_MATCH; value <= DEFLATE_MAX_MATCH; value++)
+    {
+        /* Length 258 has its own code rather than the end of code 27's range */
+        while (code < 28 && value >= lengthBase[code + 1])
+            code++;
+        lengthCodeTable[value] = code;
+    }
+
+    code = 0;
+    for (value = 1; value <= 256; value++)
+    {
+        while (code < 29 && value >= distanceBase[code + 1])
+            code++;
+        distanceCodeTable[value - 1] = code;
+    }
+
+    for (value = 256; value < 512; value++)
+    {
+        ULONG distance = (value - 256) * 128 + 1;
+        while (code < 29 && distance >= distanceBase[code + 1])
+            code++;
+        distanceCodeTable[value] = code;
+    }
+
+    /* Fixed codes of RFC 1951 3.2.6 */
+    for (value = 0; value < FIXED_LITERAL_CODES; value++)
+        fixedLiteralCode.lengths[value] = (value < 144) ? 8 : (value < 256) ? 9 : (value < 280) ? 7 : 8;
+    assignDeflateCodes(&fixedLiteralCode, FIXED_LITERAL_CODES);
+
+    for (value = 0; value < FIXED_DISTANCE_CODES; value++)
+        fixedDistanceCode.lengths[value] = FIXED_DISTANCE_BITS;
+    assignDeflateCodes(&fixedDistanceCode, FIXED_DISTANCE_CODES);
+
+    deflateTablesReady = TRUE;
+}
+
+static UBYTE getDistanceCode(ULONG distance)
+{
+    return (distance <= 256) ? distanceCodeTable[distance - 1] : distanceCodeTable[256 + ((distance - 1) >> 7)];
+}
+
+/* Append numBits (up to 16) bits, LSB first */
+static void putBits(DeflateOutput *out, ULONG value, UBYTE numBits)
+{
+    out->bitBuf |= value << out->bitCount;
+    out->bitCount += numBits;
+
+    while (out->bitCount >= 8)
+    {
+        if (out->pos < out->size)
+            out->buffer[out->pos++] = (UBYTE)out->bitBuf;
+        else
+            out->overflow = TRUE;
+
+        out->bitBuf >>= 8;
+        out->bitCount -= 8;
+    }
+}
+
+/* Pad with zero bits to the next byte boundary */
+static void alignOutput(DeflateOutput *out)
+{
+    if (out->bitCount > 0)
+        putBits(out, 0, 8 - out->bitCount);
+}
+
+/* Append whole bytes; the writer must be byte aligned */
+static void putBytes(DeflateOutput *out, UBYTE *data, ULONG length)
+{
+    if (out->pos + length > out->size)
+    {
+        out->overflow = TRUE;
+        return;
+    }
+
+    memcpy(out->buffer + out->pos, data, length);
+    out->pos += length;
+}
+
+/* Assign canonical codes to a set of lengths and bit-reverse them for output */
+static void assignDeflateCodes(DeflateCode *code, ULONG numCodes)
+{
+    ULONG blCount[MAX_BITS + 1];
+    ULONG nextCode[MAX_BITS + 1];
+    ULONG i, value = 0;
+
+    memset(blCount, 0, sizeof(blCount));
+    for (i = 0; i < numCodes; i++)
+        blCount[code->lengths[i]]++;
+    blCount[0] = 0;
+
+    for (i = 1; i <= MAX_BITS; i++)
+    {
+        value = (value + blCount[i - 1]) << 1;
+        nextCode[i] = value;
+    }
+
+    for (i = 0; i < numCodes; i++)
+    {
+        UBYTE len = code->lengths[i];
+        ULONG canonical, reversed = 0;
+        UBYTE bit;
+
+        if (len == 0)
+            continue;
+
+        canonical = nextCode[len]++;
+        for (bit = 0; bit < len; bit++)
+        {
+            reversed = (reversed << 1) | (canonical & 1);
+            canonical >>= 1;
+        }
+        code->codes[i] = (UWORD)reversed;
+    }
+}
+
+/* Code lengths for sorted frequencies, in place (Moffat and Katajainen)
+ * freq[] must be ascending; on return freq[i] is the code length of the
+ * i-th symbol, longest first */
+static void computeCodeLengths(ULONG *freq, LONG n)
+{
+    LONG root, leaf, next, avail, used, depth;
+
+    if (n == 0)
+        return;
+    if (n == 1)
+    {
+        freq[0] = 1;
+        return;
+    }
+
+    /* Combine into a tree, reusing the array for parent pointers */
+    freq[0] += freq[1];
+    root = 0;
+    leaf = 2;
+    for (next = 1; next < n - 1; next++)
+    {
+        if (leaf >= n || freq[root] < freq[leaf])
+        {
+            freq[next] = freq[root];
+            freq[root++] = next;
+        }
+        else
+        {
+            freq[next] = freq[leaf++];
+        }
+
+        if (leaf >= n || (root < next && freq[root] < freq[leaf]))
+        {
+            freq[next] += freq[root];
+            freq[root++] = next;
+        }
+        else
+        {
+            freq[next] += freq[leaf++];
+        }
+    }
+
+    /* Parent pointers to internal node depths */
+    freq[n - 2] = 0;
+    for (next = n - 3; next >= 0; next--)
+        freq[next] = freq[freq[next]] + 1;
+
+    /* Internal node depths to leaf depths */
+    avail = 1;
+    used = 0;
+    depth = 0;
+    root = n - 2;
+    next = n - 1;
+    while (avail > 0)
+    {
+        while (root >= 0 && (LONG)freq[root] == depth)
+        {
+            used++;
+            root--;
+        }
+        while (avail > used)
+        {
+            freq[next--] = depth;
+            avail--;
+        }
+        avail = 2 * used;
+        depth++;
+        used = 0;
+    }
+}
+
+/* Build a length-limited Huffman code for the given symbol frequencies
+ * At least two symbols always get a code, so decoders that insist on a
+ * complete code (and at least one distance code) accept the block */
+static void buildDeflateCode(DeflateState *state, ULONG *freq, ULONG numCodes, UBYTE maxBits, DeflateCode *code)
+{
+    ULONG lengthCount[33];
+    ULONG i, j, numUsed = 0, total;
+    LONG len;
+
+    memset(code->lengths, 0, numCodes);
+
+    /* Collect the used symbols, sorted by ascending frequency (insertion
+     * sort; alphabets are small and mostly already in order) */
+    for (i = 0; i < numCodes; i++)
+    {
+        ULONG f = freq[i];
+
+        if (f == 0 && !(numUsed < 2 && i >= numCodes - 2 + numUsed))
+            continue;
+        if (f == 0)
+            f = 1;
+
+        j = numUsed++;
+        while (j > 0 && state->sortFreq[j - 1] > f)
+        {
+            state->sortFreq[j] = state->sortFreq[j - 1];
+            state->sortSymbol[j] = state->sortSymbol[j - 1];
+            j--;
+        }
+        state->sortFreq[j] = f;
+        state->sortSymbol[j] = i;
+    }
+
+    computeCodeLengths(state->sortFreq, numUsed);
+
+    /* Count codes per length, folding anything too long into maxBits */
+    memset(lengthCount, 0, sizeof(lengthCount));
+    for (i = 0; i < numUsed; i++)
+    {
+        len = state->sortFreq[i];
+        lengthCount[len > (LONG)maxBits ? maxBits : len]++;
+    }
+
+    /* Folding over-subscribes the code; lengthen shorter codes until the
+     * Kraft sum is exactly one again */
+    total = 0;
+    for (len = maxBits; len > 0; len--)
+        total += lengthCount[len] << (maxBits - len);
+
+    while (total > (1UL << maxBits))
+    {
+        lengthCount[maxBits]--;
+        for (len = maxBits - 1; len > 0; len--)
+        {
+            if (lengthCount[len])
+            {
+                lengthCount[len]--;
+                lengthCount[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    /* Shortest codes to the most frequent symbols */
+    j = numUsed;
+    for (len = 1; len <= (LONG)maxBits; len++)
+    {
+        for (i = lengthCount[len]; i > 0; i--)
+            code->lengths[state->sortSymbol[--j]] = (UBYTE)len;
+    }
+
+    assignDeflateCodes(code, numCodes);
+}
+
+/* Run-length code the literal/length and distance code lengths of a
+ * dynamic block header with code length symbols 16, 17 and 18 */
+static void encodeCodeLengths(DeflateState *state, ULONG hlit, ULONG hdist)
+{
+    UBYTE lengths[MAX_LITERAL_CODES + MAX_DISTANCE_CODES];
+    ULONG total = hlit + hdist;
+    ULONG i = 0, run;
+
+    memcpy(lengths, state->literalCode.lengths, hlit);
+    memcpy(lengths + hlit, state->distanceCode.lengths, hdist);
+
+    state->codeLengthSymbolCount = 0;
+    memset(state->codeLengthFreq, 0, sizeof(state->codeLengthFreq));
+
+    while (i < total)
+    {
+        UBYTE len = lengths[i];
+        UBYTE symbol, extra = 0;
+
+        run = 1;
+        while (i + run < total && lengths[i + run] == len)
+            run++;
+
+        if (len == 0 && run >= 11)
+        {
+            if (run > 138)
+                run = 138;
+            symbol = CODELEN_REPEAT_ZERO_LONG;
+            extra = run - 11;
+        }
+        else if (len == 0 && run >= 3)
+        {
+            symbol = CODELEN_REPEAT_ZERO;
+            extra = run - 3;
+        }
+        else if (len != 0 && run >= 4)
+        {
+            /* The length itself, then repeats of it */
+            state->codeLengthSymbols[state->codeLengthSymbolCount] = len;
+            state->codeLengthExtra[state->codeLengthSymbolCount++] = 0;
+            state->codeLengthFreq[len]++;
+            i++;
+            run--;
+            if (run > 6)
+                run = 6;
+            symbol = CODELEN_REPEAT_PREVIOUS;
+            extra = run - 3;
+        }
+        else
+        {
+            run = 1;
+            symbol = len;
+        }
+
+        state->codeLengthSymbols[state->codeLengthSymbolCount] = symbol;
+        state->codeLengthExtra[state->codeLengthSymbolCount++] = extra;
+        state->codeLengthFreq[symbol]++;
+        i += run;
+    }
+}
+
+/* Bits of length and distance extra data in the pending block */
+static ULONG countExtraBits(DeflateState *state)
+{
+    const UBYTE *lengthExtraBits = getLengthExtraBits();
+    const UBYTE *distanceExtraBits = getDistanceExtraBits();
+    ULONG bits = 0, i;
+
+    for (i = 0; i < MAX_LITERAL_CODES - 257; i++)
+        bits += state->literalFreq[257 + i] * lengthExtraBits[i];
+    for (i = 0; i < MAX_DISTANCE_CODES; i++)
+        bits += state->distanceFreq[i] * distanceExtraBits[i];
+
+    return bits;
+}
+
+/* Bits needed to code the pending symbols with the given codes */
+static ULONG countSymbolBits(DeflateState *state, DeflateCode *literals, DeflateCode *distances)
+{
+    ULONG bits = 0, i;
+
+    for (i = 0; i < MAX_LITERAL_CODES; i++)
+        bits += state->literalFreq[i] * literals->lengths[i];
+    for (i = 0; i < MAX_DISTANCE_CODES; i++)
+        bits += state->distanceFreq[i] * distances->lengths[i];
+
+    return bits;
+}
+
+/* Write the pending symbols and the end-of-block code */
+static void writeBlockSymbols(DeflateState *state, DeflateCode *literals, DeflateCode *distances)
+{
+    const UWORD *lengthBase = getLengthBase();
+    const UBYTE *lengthExtraBits = getLengthExtraBits();
+    const UWORD *distanceBase = getDistanceBase();
+    const UBYTE *distanceExtraBits = getDistanceExtraBits();
+    DeflateOutput *out = state->out;
+    ULONG i;
+
+    for (i = 0; i < state->symbolCount; i++)
+    {
+        ULONG value = state->symbolLitLen[i];
+        ULONG distance = state->symbolDist[i];
+        UBYTE code;
+
+        if (distance == 0)
+        {
+            putBits(out, literals->codes[value], literals->lengths[value]);
+            continue;
+        }
+
+        code = lengthCodeTable[value];
+        putBits(out, literals->codes[257 + code], literals->lengths[257 + code]);
+        if (lengthExtraBits[code])
+            putBits(out, value - lengthBase[code], lengthExtraBits[code]);
+
+        code = getDistanceCode(distance);
+        putBits(out, distances->codes[code], distances->lengths[code]);
+        if (distanceExtraBits[code])
+            putBits(out, distance - distanceBase[code], distanceExtraBits[code]);
+    }
+
+    putBits(out, literals->codes[END_OF_BLOCK], literals->lengths[END_OF_BLOCK]);
+}
+
+/* Write data[start..end) as stored blocks of at most DEFLATE_STORED_MAX bytes */
+static void writeStoredBlocks(DeflateOutput *out, UBYTE *data, ULONG start, ULONG end, BOOL final)
+{
+    ULONG pos = start;
+    ULONG length;
+
+    do
+    {
+        length = end - pos;
+        if (length > DEFLATE_STORED_MAX)
+            length = DEFLATE_STORED_MAX;
+
+        putBits(out, (final && pos + length == end) ? 1 : 0, 3);
+        alignOutput(out);
+        putBits(out, length, 16);
+        putBits(out, length ^ 0xFFFF, 16);
+        putBytes(out, data + pos, length);
+        pos += length;
+    } while (pos < end);
+}
+
+/* Emit the pending symbols as one block, picking the cheapest coding */
+static void flushDeflateBlock(DeflateState *state, BOOL final)
+{
+    static const UBYTE codeLengthOrder[MAX_CODE_LENGTHS] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    DeflateOutput *out = state->out;
+    ULONG hlit, hdist, hclen, i;
+    ULONG dynamicBits, fixedBits, storedBits, extraBits;
+
+    /* Symbol statistics */
+    memset(state->literalFreq, 0, sizeof(state->literalFreq));
+    memset(state->distanceFreq, 0, sizeof(state->distanceFreq));
+    for (i = 0; i < state->symbolCount; i++)
+    {
+        if (state->symbolDist[i] == 0)
+        {
+            state->literalFreq[state->symbolLitLen[i]]++;
+        }
+        else
+        {
+            state->literalFreq[257 + lengthCodeTable[state->symbolLitLen[i]]]++;
+            state->distanceFreq[getDistanceCode(state->symbolDist[i])]++;
+        }
+    }
+    state->literalFreq[END_OF_BLOCK] = 1;
+
+    /* Dynamic codes and the header that describes them */
+    buildDeflateCode(state, state->literalFreq, MAX_LITERAL_CODES, DEFLATE_MAX_CODE_BITS, &state->literalCode);
+    buildDeflateCode(state, state->distanceFreq, MAX_DISTANCE_CODES, DEFLATE_MAX_CODE_BITS, &state->distanceCode);
+
+    for (hlit = MAX_LITERAL_CODES; hlit > 257 && state->literalCode.lengths[hlit - 1] == 0; hlit--)
+        ;
+    for (hdist = MAX_DISTANCE_CODES; hdist > 1 && state->distanceCode.lengths[hdist - 1] == 0; hdist--)
+        ;
+
+    encodeCodeLengths(state, hlit, hdist);
+    buildDeflateCode(state, state->codeLengthFreq, MAX_CODE_LENGTHS, DEFLATE_MAX_CODELEN_BITS, &state->codeLengthCode);
+
+    for (hclen = MAX_CODE_LENGTHS; hclen > 4 && state->codeLengthCode.lengths[codeLengthOrder[hclen - 1]] == 0; hclen--)
+        ;
+
+    /* Compare the three codings */
+    extraBits = countExtraBits(state);
+
+    dynamicBits = 3 + 5 + 5 + 4 + 3 * hclen + extraBits;
+    for (i = 0; i < state->codeLengthSymbolCount; i++)
+    {
+        UBYTE symbol = state->codeLengthSymbols[i];
+        dynamicBits += state->codeLengthCode.lengths[symbol];
+        dynamicBits += (symbol == CODELEN_REPEAT_PREVIOUS) ? 2 : (symbol == CODELEN_REPEAT_ZERO) ? 3 : (symbol == CODELEN_REPEAT_ZERO_LONG) ? 7 : 0;
+    }
+    dynamicBits += countSymbolBits(state, &state->literalCode, &state->distanceCode);
+
+    fixedBits = 3 + extraBits + countSymbolBits(state, &fixedLiteralCode, &fixedDistanceCode);
+
+    storedBits = (state->blockEnd - state->blockStart) * 8 +
+                 ((state->blockEnd - state->blockStart) / DEFLATE_STORED_MAX + 1) * (32 + 3 + 7);
+
+    if (storedBits <= fixedBits && storedBits <= dynamicBits)
+    {
+        writeStoredBlocks(out, state->data, state->blockStart, state->blockEnd, final);
+    }
+    else if (fixedBits <= dynamicBits)
+    {
+        putBits(out, final ? 1 : 0, 1);
+        putBits(out, 1, 2);
+        writeBlockSymbols(state, &fixedLiteralCode, &fixedDistanceCode);
+    }
+    else
+    {
+        putBits(out, final ? 1 : 0, 1);
+        putBits(out, 2, 2);
+        putBits(out, hlit - 257, 5);
+        putBits(out, hdist - 1, 5);
+        putBits(out, hclen - 4, 4);
+        for (i = 0; i < hclen; i++)
+            putBits(out, state->codeLengthCode.lengths[codeLengthOrder[i]], 3);
+
+        for (i = 0; i < state->codeLengthSymbolCount; i++)
+        {
+            UBYTE symbol = state->codeLengthSymbols[i];
+
+            putBits(out, state->codeLengthCode.codes[symbol], state->codeLengthCode.lengths[symbol]);
+            if (symbol == CODELEN_REPEAT_PREVIOUS)
+                putBits(out, state->codeLengthExtra[i], 2);
+            else if (symbol == CODELEN_REPEAT_ZERO)
+                putBits(out, state->codeLengthExtra[i], 3);
+            else if (symbol == CODELEN_REPEAT_ZERO_LONG)
+                putBits(out, state->codeLengthExtra[i], 7);
+        }
+
+        writeBlockSymbols(state, &state->literalCode, &state->distanceCode);
+    }
+
+    state->symbolCount = 0;
+    state->blockStart = state->blockEnd;
+}
+
+/* Record a literal, emitting the block when the symbol buffer is full */
+static void tallyLiteral(DeflateState *state, UBYTE literal)
+{
+    state->symbolLitLen[state->symbolCount] = literal;
+    state->symbolDist[state->symbolCount++] = 0;
+    state->blockEnd++;
+
+    if (state->symbolCount == DEFLATE_BLOCK_SYMBOLS)
+        flushDeflateBlock(state, FALSE);
+}
+
+/* Record a match, emitting the block when the symbol buffer is full */
+static void tallyMatch(DeflateState *state, ULONG length, ULONG distance)
+{
+    state->symbolLitLen[state->symbolCount] = (UWORD)length;
+    state->symbolDist[state->symbolCount++] = (UWORD)distance;
+    state->blockEnd += length;
+
+    if (state->symbolCount == DEFLATE_BLOCK_SYMBOLS)
+        flushDeflateBlock(state, FALSE);
+}
+
+/* Add the string starting at pos to its hash chain */
+static void insertString(DeflateState *state, ULONG pos)
+{
+    UBYTE *p = state->data + pos;
+    ULONG hash, last;
+
+    if (pos + DEFLATE_MIN_MATCH > state->size)
+        return;
+
+    hash = (((ULONG)p[0] << 10) ^ ((ULONG)p[1] << 5) ^ p[2]) & (DEFLATE_HASH_SIZE - 1);
+    last = state->head[hash];
+
+    state->prev[pos & DEFLATE_WINDOW_MASK] = (last && pos - (last - 1) <= DEFLATE_WINDOW_SIZE) ? (UWORD)(pos - (last - 1)) : 0;
+    state->head[hash] = pos + 1;
+}
+
+/* Find the longest match for pos that beats bestLength by walking the
+ * hash chain; pos must already be inserted. Returns the best length
+ * found (bestLength itself when nothing longer turned up) */
+static ULONG findLongestMatch(DeflateState *state, ULONG pos, ULONG bestLength, ULONG *matchDistance)
+{
+    const DeflateConfig *config = state->config;
+    UBYTE *scan = state->data + pos;
+    ULONG maxLength = state->size - pos;
+    ULONG chain = config->maxChain;
+    ULONG niceLength = config->niceLength;
+    ULONG candidate = pos;
+    ULONG delta, length;
+
+    if (maxLength > DEFLATE_MAX_MATCH)
+        maxLength = DEFLATE_MAX_MATCH;
+    if (niceLength > maxLength)
+        niceLength = maxLength;
+    if (bestLength >= config->goodLength)
+        chain >>= 2;
+    if (bestLength >= maxLength)
+        return bestLength;
+
+    while (chain-- > 0)
+    {
+        UBYTE *match;
+
+        delta = state->prev[candidate & DEFLATE_WINDOW_MASK];
+        if (delta == 0 || delta > candidate)
+            break;
+        candidate -= delta;
+        if (pos - candidate > DEFLATE_WINDOW_SIZE)
+            break;
+
+        /* Cheap rejects before the full compare */
+        match = state->data + candidate;
+        if (match[bestLength] != scan[bestLength] || match[0] != scan[0] || match[1] != scan[1])
+            continue;
+
+        length = 2;
+        while (length < maxLength && match[length] == scan[length])
+            length++;
+
+        if (length > bestLength)
+        {
+            bestLength = length;
+            *matchDistance = pos - candidate;
+            if (length >= niceLength)
+                break;
+        }
+    }
+
+    return bestLength;
+}
+
+/* Greedy matching (levels 1-3): take the first match found at each position */
+static void deflateGreedy(DeflateState *state)
+{
+    ULONG pos = 0;
+    ULONG length, distance = 0, end;
+
+    while (pos < state->size)
+    {
+        length = 0;
+        if (pos + DEFLATE_MIN_MATCH <= state->size)
+        {
+            insertString(state, pos);
+            length = findLongestMatch(state, pos, DEFLATE_MIN_MATCH - 1, &distance);
+        }
+
+        if (length < DEFLATE_MIN_MATCH)
+        {
+            tallyLiteral(state, state->data[pos]);
+            pos++;
+            continue;
+        }
+
+        tallyMatch(state, length, distance);
+
+        /* Hashing every string inside long matches costs more than it finds */
+        end = pos + length;
+        if (length <= state->config->maxLazy)
+        {
+            while (++pos < end)
+                insertString(state, pos);
+        }
+        pos = end;
+    }
+}
+
+/* Lazy matching (levels 4-9): keep a match back for one byte in case
+ * the next position starts a longer one */
+static void deflateLazy(DeflateState *state)
+{
+    ULONG pos = 0;
+    ULONG prevLength = DEFLATE_MIN_MATCH - 1, prevDistance = 0;
+    ULONG length, distance, end;
+    BOOL matchAvailable = FALSE;
+
+    while (pos < state->size)
+    {
+        length = DEFLATE_MIN_MATCH - 1;
+        distance = 0;
+
+        if (pos + DEFLATE_MIN_MATCH <= state->size)
+        {
+            insertString(state, pos);
+            if (prevLength < state->config->maxLazy)
+            {
+                length = findLongestMatch(state, pos, prevLength, &distance);
+                if (length <= prevLength)
+                    length = DEFLATE_MIN_MATCH - 1;
+                else if (length == DEFLATE_MIN_MATCH && distance > DEFLATE_TOO_FAR)
+                    length = DEFLATE_MIN_MATCH - 1;
+            }
+        }
+
+        if (prevLength >= DEFLATE_MIN_MATCH && length <= prevLength)
+        {
+            /* The match held back from pos - 1 wins */
+            tallyMatch(state, prevLength, prevDistance);
+
+            end = pos - 1 + prevLength;
+            while (++pos < end)
+                insertString(state, pos);
+
+            matchAvailable = FALSE;
+            prevLength = DEFLATE_MIN_MATCH - 1;
+        }
+        else
+        {
+            /* The byte before pos goes out as a literal */
+            if (matchAvailable)
+                tallyLiteral(state, state->data[pos - 1]);
+
+            matchAvailable = TRUE;
+            prevLength = length;
+            prevDistance = distance;
+            pos++;
+        }
+    }
+
+    if (matchAvailable)
+        tallyLiteral(state, state->data[pos - 1]);
+}
+
+/* RLE level: one fixed Huffman block per DEFLATE_STORED_MAX bytes of
+ * input, using only literals and distance-1 matches. A block that comes
+ * out larger than the input is rewound and written stored instead */
+static void deflateRLE(DeflateOutput *out, UBYTE *data, ULONG size)
+{
+    const UWORD *lengthBase = getLengthBase();
+    const UBYTE *lengthExtraBits = getLengthExtraBits();
+    DeflateOutput blockStart;
+    ULONG start = 0, end, pos, run, limit;
+    UBYTE code, previous;
+
+    do
+    {
+        end = start + DEFLATE_STORED_MAX;
+        if (end > size)
+            end = size;
+
+        blockStart = *out;
+        putBits(out, (end == size) ? 1 : 0, 1);
+        putBits(out, 1, 2);
+
+        pos = start;
+        while (pos < end)
+        {
+            /* Length of the run repeating the byte before pos */
+            run = 0;
+            if (pos > 0)
+            {
+                previous = data[pos - 1];
+                limit = end - pos;
+                if (limit > DEFLATE_MAX_MATCH)
+                    limit = DEFLATE_MAX_MATCH;
+                while (run < limit && data[pos + run] == previous)
+                    run++;
+            }
+
+            if (run < DEFLATE_MIN_MATCH)
+            {
+                putBits(out, fixedLiteralCode.codes[data[pos]], fixedLiteralCode.lengths[data[pos]]);
+                pos++;
+                continue;
+            }
+
+            code = lengthCodeTable[run];
+            putBits(out, fixedLiteralCode.codes[257 + code], fixedLiteralCode.lengths[257 + code]);
+            if (lengthExtraBits[code])
+                putBits(out, run - lengthBase[code], lengthExtraBits[code]);
+            putBits(out, fixedDistanceCode.codes[0], FIXED_DISTANCE_BITS);
+            pos += run;
+        }
+
+        putBits(out, fixedLiteralCode.codes[END_OF_BLOCK], fixedLiteralCode.lengths[END_OF_BLOCK]);
+
+        /* Bytes written past a full buffer are dropped, so rewinding is safe */
+        if ((out->overflow && !blockStart.overflow) ||
+            (out->pos - blockStart.pos) * 8 + out->bitCount - blockStart.bitCount > (end - start) * 8 + 32 + 3 + 7)
+        {
+            *out = blockStart;
+            writeStoredBlocks(out, data, start, end, end == size);
+        }
+
+        start = end;
+    } while (start < size);
+}
+
+/* Largest output deflateData can produce for sourceSize bytes of input */
+ULONG getDeflateBound(ULONG sourceSize)
+{
+    return sourceSize + (sourceSize >> 11) + 32;
+}
+
+/* Compress size bytes of data into a caller-supplied buffer */
+BOOL deflateData(UBYTE *data, ULONG size, UBYTE *output, ULONG outputSize, ULONG *compressedSize,
+                 UBYTE level, UBYTE format)
+{
+    char logMessage[256];
+    DeflateOutput out;
+    DeflateState *state;
+    ULONG adler;
+
+    if ((!data && size > 0) || !output || !compressedSize)
+    {
+        LOG_DEBUG("Invalid parameters for deflateData");
+        return FALSE;
+    }
+
+    *compressedSize = 0;
+    if (level > DEFLATE_LEVEL_BEST && level != DEFLATE_LEVEL_RLE)
+        level = DEFLATE_LEVEL_BEST;
+
+    if (!deflateTablesReady)
+        buildDeflateTables();
+
+    out.buffer = output;
+    out.size = outputSize;
+    out.pos = 0;
+    out.bitBuf = 0;
+    out.bitCount = 0;
+    out.overflow = FALSE;
+
+    if (format == DEFLATE_FORMAT_ZLIB)
+    {
+        /* CM 8 with a 32 KB window, FLEVEL from the level, FCHECK to make the pair a multiple of 31 */
+        UBYTE flevel = (level < 2 || level == DEFLATE_LEVEL_RLE) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+        ULONG header = (0x78 << 8) | (flevel << 6);
+
+        header += 31 - (header % 31);
+        putBits(&out, header >> 8, 8);
+        putBits(&out, header & 0xFF, 8);
+    }
+
+    if (level == DEFLATE_LEVEL_NONE)
+    {
+        writeStoredBlocks(&out, data, 0, size, TRUE);
+    }
+    else if (level == DEFLATE_LEVEL_RLE)
+    {
+        /* No match finder, so no state to allocate */
+        deflateRLE(&out, data, size);
+    }
+    else
+    {
+        state = (DeflateState *)malloc(sizeof(DeflateState));
+        if (!state)
+        {
+            LOG_DEBUG("Failed to allocate memory for deflate state");
+            return FALSE;
+        }
+
+        state->data = data;
+        state->size = size;
+        state->config = &deflateConfigs[level];
+        state->out = &out;
+        state->symbolCount = 0;
+        state->blockStart = 0;
+        state->blockEnd = 0;
+        memset(state->head, 0, sizeof(state->head));
+
+        if (state->config->lazy)
+            deflateLazy(state);
+        else
+            deflateGreedy(state);
+
+        flushDeflateBlock(state, TRUE);
+        free(state);
+    }
+
+    alignOutput(&out);
+
+    if (format == DEFLATE_FORMAT_ZLIB)
+    {
+        adler = adler32Update(1, data, size);
+        putBits(&out, (adler >> 24) & 0xFF, 8);
+        putBits(&out, (adler >> 16) & 0xFF, 8);
+        putBits(&out, (adler >> 8) & 0xFF, 8);
+        putBits(&out, adler & 0xFF, 8);
+    }
+
+    if (out.overflow)
+    {
+        LOG_DEBUG("Output buffer too small for deflated data");
+        return FALSE;
+    }
+
+    *compressedSize = out.pos;
+    LOG_DEBUGF(logMessage, "Deflated %lu bytes to %lu bytes at level %u", size, *compressedSize, level);
+
+    return TRUE;
+}
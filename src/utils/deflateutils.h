@@ -0,0 +1,49 @@
+/*
+ * DEFLATE/zlib compression for AmigaOS 3.1
+ * Used for saving PNG images and compressed editor data
+ */
+
+#ifndef DEFLATEUTILS_H
+#define DEFLATEUTILS_H
+
+#include <exec/types.h>
+
+/* Compression levels: higher levels search harder for matches */
+#define DEFLATE_LEVEL_NONE 0    /* Stored blocks only */
+#define DEFLATE_LEVEL_FASTEST 1 /* Greedy matching with very short hash chains */
+#define DEFLATE_LEVEL_DEFAULT 6 /* Lazy matching, zlib's default trade-off */
+#define DEFLATE_LEVEL_BEST 9    /* Lazy matching with long hash chains */
+
+/* Special level outside the 0-9 scale: literals and distance-1 runs only,
+ * with fixed Huffman codes. No match finder and no allocation, so it is
+ * the quickest way to shrink flat-colour sprites and tile maps for
+ * autosaves; noisy data compresses poorly */
+#define DEFLATE_LEVEL_RLE 10
+
+/* Output formats for deflateData */
+#define DEFLATE_FORMAT_RAW 0  /* Bare DEFLATE blocks */
+#define DEFLATE_FORMAT_ZLIB 1 /* RFC 1950 header and Adler-32 trailer */
+
+/* Match finder geometry */
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_WINDOW_MASK (DEFLATE_WINDOW_SIZE - 1)
+#define DEFLATE_HASH_BITS 14
+#define DEFLATE_HASH_SIZE (1UL << DEFLATE_HASH_BITS)
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+/* LZ77 symbols collected before a block is emitted */
+#define DEFLATE_BLOCK_SYMBOLS 16384
+
+/* Largest output deflateData can produce for sourceSize bytes of input
+ * Every block falls back to stored form when that is smaller, so the
+ * worst case is the input plus stored block headers and the zlib wrapper */
+ULONG getDeflateBound(ULONG sourceSize);
+
+/* Compress size bytes of data into a caller-supplied buffer
+ * level is DEFLATE_LEVEL_NONE to DEFLATE_LEVEL_BEST or DEFLATE_LEVEL_RLE; fails if the
+ * output does not fit in outputSize bytes */
+BOOL deflateData(UBYTE *data, ULONG size, UBYTE *output, ULONG outputSize, ULONG *compressedSize,
+                 UBYTE level, UBYTE format);
+
+#endif /* DEFLATEUTILS_H */
@@ -26,4 +26,93 @@ extern void fileLoggerClose(void);
 extern BOOL loggerFormatMessage(char *outBuf, const char *format, ...);
 extern FileLogger *fileLogger;
 
+/*
+ * Compile-time log levels for codec and other hot-path code.
+ * Build with -DLOG_LEVEL=LOG_LEVEL_ERROR (the "release" make target) and
+ * every LOG_INFO / LOG_DEBUG / LOG_TRACE call, including its sprintf,
+ * compiles away. A disabled call still evaluates to its message argument so
+ * parameters that are only logged do not trigger unused warnings; keep
+ * values that exist only for logging inside the call itself.
+ * Debug and trace calls that remain check fileLogger->isDebug before
+ * formatting anything.
+ */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4 /* Per-block / per-chunk messages */
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_TRACE
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG_ENABLED (fileLogger && fileLogger->isDebug)
+#else
+#define LOG_DEBUG_ENABLED 0
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(msg) fileLoggerAddErrorEntry(msg)
+#define LOG_ERRORF(buffer, ...)             \
+    do                                      \
+    {                                       \
+        if (fileLogger)                     \
+        {                                   \
+            sprintf(buffer, __VA_ARGS__);   \
+            fileLoggerAddErrorEntry(buffer);\
+        }                                   \
+    } while (0)
+#else
+#define LOG_ERROR(msg) ((void)(msg))
+#define LOG_ERRORF(buffer, ...) ((void)(buffer))
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(msg) fileLoggerAddEntry(msg)
+#define LOG_INFOF(buffer, ...)              \
+    do                                      \
+    {                                       \
+        if (fileLogger)                     \
+        {                                   \
+            sprintf(buffer, __VA_ARGS__);   \
+            fileLoggerAddEntry(buffer);     \
+        }                                   \
+    } while (0)
+#else
+#define LOG_INFO(msg) ((void)(msg))
+#define LOG_INFOF(buffer, ...) ((void)(buffer))
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(msg)                       \
+    do                                       \
+    {                                        \
+        if (LOG_DEBUG_ENABLED)               \
+        {                                    \
+            fileLoggerAddDebugEntry(msg);    \
+        }                                    \
+    } while (0)
+#define LOG_DEBUGF(buffer, ...)              \
+    do                                       \
+    {                                        \
+        if (LOG_DEBUG_ENABLED)               \
+        {                                    \
+            sprintf(buffer, __VA_ARGS__);    \
+            fileLoggerAddDebugEntry(buffer); \
+        }                                    \
+    } while (0)
+#else
+#define LOG_DEBUG(msg) ((void)(msg))
+#define LOG_DEBUGF(buffer, ...) ((void)(buffer))
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(msg) LOG_DEBUG(msg)
+#define LOG_TRACEF(buffer, ...) LOG_DEBUGF(buffer, __VA_ARGS__)
+#else
+#define LOG_TRACE(msg) ((void)(msg))
+#define LOG_TRACEF(buffer, ...) ((void)(buffer))
+#endif
+
 #endif
\ No newline at end of file
@@ -43,544 +43,379 @@ const UBYTE *getCodeLengthCodeOrder(void)
     return codelenCodeOrder;
 }
 
-/* Process a dynamic Huffman (type 2) DEFLATE block - actual implementation */
-BOOL processDynamicHuffmanBlock(BitBuffer *bitBuf, UBYTE *compressedData, ULONG compressedSize,
-                                UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos)
+/* Get the base lengths for length codes 257-285 */
+const UWORD *getLengthBase(void)
 {
-    char logMessage[256];
-    ULONG hlit, hdist, hclen;
-    UBYTE codeLengths[MAX_CODE_LENGTHS];
-    UBYTE literalLengths[MAX_LITERAL_CODES];
-    UBYTE distanceLengths[MAX_DISTANCE_CODES];
-    ULONG i, j, repeat;
-    UWORD decodedValue;
-    UBYTE bitValue;
-    const UBYTE *codelenCodeOrder = getCodeLengthCodeOrder();
-
-    /* Initialize all code lengths to 0 */
-    for (i = 0; i < MAX_CODE_LENGTHS; i++)
-        codeLengths[i] = 0;
-
-    for (i = 0; i < MAX_LITERAL_CODES; i++)
-        literalLengths[i] = 0;
-
-    for (i = 0; i < MAX_DISTANCE_CODES; i++)
-        distanceLengths[i] = 0;
-
-    /* Read the header of the dynamic Huffman block */
-    if (!readBits(bitBuf, 5, &bitValue))
-        return FALSE;
-    hlit = bitValue + 257; /* Number of literal/length codes (257-286) */
+    return lengthBase;
+}
 
-    if (!readBits(bitBuf, 5, &bitValue))
-        return FALSE;
-    hdist = bitValue + 1; /* Number of distance codes (1-32) */
+/* Get the extra bit counts for length codes 257-285 */
+const UBYTE *getLengthExtraBits(void)
+{
+    return lengthExtraBits;
+}
 
-    if (!readBits(bitBuf, 4, &bitValue))
-        return FALSE;
-    hclen = bitValue + 4; /* Number of code length codes (4-19) */
+/* Get the base distances for distance codes 0-29 */
+const UWORD *getDistanceBase(void)
+{
+    return distanceBase;
+}
 
-    sprintf(logMessage, "Dynamic Huffman block: HLIT=%lu, HDIST=%lu, HCLEN=%lu", hlit, hdist, hclen);
-    fileLoggerAddDebugEntry(logMessage);
+/* Get the extra bit counts for distance codes 0-29 */
+const UBYTE *getDistanceExtraBits(void)
+{
+    return distanceExtraBits;
+}
 
-    /* Validate the ranges */
-    if (hlit > MAX_LITERAL_CODES || hdist > MAX_DISTANCE_CODES)
-    {
-        fileLoggerAddDebugEntry("Invalid dynamic Huffman code counts");
-        return FALSE;
-    }
+/* Reverse the low numBits bits of a canonical Huffman code.
+ * DEFLATE packs Huffman codes MSB first but the bit stream is read LSB
+ * first, so the lookup tables are indexed by the reversed code */
+static UWORD reverseHuffmanCode(ULONG code, UBYTE numBits)
+{
+    UWORD reversed = 0;
 
-    /* Read code lengths for the code length alphabet */
-    for (i = 0; i < hclen; i++)
+    while (numBits--)
     {
-        if (!readBits(bitBuf, 3, &bitValue))
-            return FALSE;
-        codeLengths[codelenCodeOrder[i]] = bitValue;
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
     }
 
-    fileLoggerAddDebugEntry("Read code length codes");
-
-    /* Build the Huffman tree for the code length alphabet */
-    HuffmanTable codeLengthTable;
-    if (!buildHuffmanTreeFromCodeLengths(codeLengths, MAX_CODE_LENGTHS, &codeLengthTable))
-    {
-        fileLoggerAddDebugEntry("Failed to build Huffman tree for code lengths");
-        return FALSE;
-    }
+    return reversed;
+}
 
-    // fileLoggerAddDebugEntry("Built Huffman tree for code lengths");
+/* Check the code length counts against the Kraft inequality
+ * Walks the lengths from 1 up, tracking how many codes of the current
+ * length are still unassigned; going negative means over-subscribed and
+ * anything left at the end means incomplete. A set with zero or one code
+ * is accepted, as RFC 1951 allows a single distance code */
+static UBYTE checkHuffmanCodeCounts(const ULONG *blCount)
+{
+    ULONG used = 0;
+    LONG left = 1;
+    ULONG i;
 
-    /* Use the code length table to decode the literal/length and distance code lengths */
-    /* First decode literal/length code lengths */
-    i = 0;
-    while (i < hlit)
+    for (i = 1; i <= MAX_BITS; i++)
     {
-        if (!decodeHuffmanValue(bitBuf, &codeLengthTable, &decodedValue))
-        {
-            fileLoggerAddDebugEntry("Error decoding literal/length code length");
-            freeHuffmanTable(&codeLengthTable);
-            return FALSE;
-        }
+        left = (left << 1) - (LONG)blCount[i];
+        if (left < 0)
+            return HUFFMAN_CODES_OVERSUBSCRIBED;
+        used += blCount[i];
+    }
 
-        if (decodedValue < 16)
-        {
-            /* Direct code length 0-15 */
-            literalLengths[i++] = decodedValue;
-        }
-        else if (decodedValue == 16)
-        {
-            /* Repeat previous code length 3-6 times */
-            UBYTE prevLen = (i > 0) ? literalLengths[i - 1] : 0;
-            UBYTE repeatCount;
+    if (left > 0 && used > 1)
+        return HUFFMAN_CODES_INCOMPLETE;
 
-            if (!readBits(bitBuf, 2, &repeatCount))
-            {
-                freeHuffmanTable(&codeLengthTable);
-                return FALSE;
-            }
-            repeatCount += 3;
+    return HUFFMAN_CODES_COMPLETE;
+}
 
-            for (j = 0; j < repeatCount && i < hlit; j++)
-                literalLengths[i++] = prevLen;
-        }
-        else if (decodedValue == 17)
-        {
-            /* Repeat code length 0 for 3-10 times */
-            UBYTE repeatCount;
+/* Build a Huffman tree from code lengths, allocating exactly the lookup table it needs */
+BOOL buildHuffmanTreeFromCodeLengths(UBYTE *codeLengths, ULONG numCodes, HuffmanTable *table)
+{
+    return buildHuffmanTableInto(codeLengths, numCodes, table, NULL, 0);
+}
 
-            if (!readBits(bitBuf, 3, &repeatCount))
-            {
-                freeHuffmanTable(&codeLengthTable);
-                return FALSE;
-            }
-            repeatCount += 3;
+/* Build a Huffman lookup table from code lengths according to RFC 1951
+ * This algorithm constructs canonical Huffman codes from code lengths and
+ * expands them into a primary table indexed by the next rootBits bits of
+ * the stream. Codes longer than rootBits get a sub-table sized to the
+ * longest code sharing that root prefix.
+ * With storage == NULL the entries are allocated, otherwise the table is
+ * built in place and fails if it needs more than storageSize entries.
+ */
+BOOL buildHuffmanTableInto(UBYTE *codeLengths, ULONG numCodes, HuffmanTable *table,
+                           HuffmanEntry *storage, ULONG storageSize)
+{
+    ULONG i, j;
+    ULONG code = 0;
+    UBYTE maxBits = 0;
+    UBYTE rootBits;
+    ULONG rootSize, numEntries;
+    ULONG blCount[MAX_BITS + 1];
+    ULONG nextCode[MAX_BITS + 1];
+    UBYTE subTableBits[1 << HUFFMAN_LITERAL_ROOT_BITS];
+    HuffmanEntry *entry;
+    char logMessage[256];
 
-            for (j = 0; j < repeatCount && i < hlit; j++)
-                literalLengths[i++] = 0;
-        }
-        else if (decodedValue == 18)
-        {
-            /* Repeat code length 0 for 11-138 times */
-            UBYTE repeatCount;
+    if (!codeLengths || !table)
+    {
+        LOG_DEBUG("Invalid parameters for buildHuffmanTreeFromCodeLengths");
+        return FALSE;
+    }
 
-            if (!readBits(bitBuf, 7, &repeatCount))
-            {
-                freeHuffmanTable(&codeLengthTable);
-                return FALSE;
-            }
-            repeatCount += 11;
+    table->entries = NULL;
+    table->allocated = FALSE;
+    table->maxCodes = numCodes;
+    table->status = HUFFMAN_CODES_COMPLETE;
 
-            for (j = 0; j < repeatCount && i < hlit; j++)
-                literalLengths[i++] = 0;
-        }
-    }
+    /* Count the number of codes for each bit length */
+    for (i = 0; i <= MAX_BITS; i++)
+        blCount[i] = 0;
 
-    /* Now decode distance code lengths */
-    i = 0;
-    while (i < hdist)
+    for (i = 0; i < numCodes; i++)
     {
-        if (!decodeHuffmanValue(bitBuf, &codeLengthTable, &decodedValue))
+        if (codeLengths[i] > MAX_BITS)
         {
-            fileLoggerAddDebugEntry("Error decoding distance code length");
-            freeHuffmanTable(&codeLengthTable);
+            LOG_DEBUGF(logMessage, "Invalid Huffman code length %u for symbol %lu", codeLengths[i], i);
+            table->status = HUFFMAN_CODES_OVERSUBSCRIBED;
             return FALSE;
         }
 
-        if (decodedValue < 16)
-        {
-            /* Direct code length 0-15 */
-            distanceLengths[i++] = decodedValue;
-        }
-        else if (decodedValue == 16)
-        {
-            /* Repeat previous code length 3-6 times */
-            UBYTE prevLen = (i > 0) ? distanceLengths[i - 1] : 0;
-            UBYTE repeatCount;
-
-            if (!readBits(bitBuf, 2, &repeatCount))
-            {
-                freeHuffmanTable(&codeLengthTable);
-                return FALSE;
-            }
-            repeatCount += 3;
-
-            for (j = 0; j < repeatCount && i < hdist; j++)
-                distanceLengths[i++] = prevLen;
-        }
-        else if (decodedValue == 17)
-        {
-            /* Repeat code length 0 for 3-10 times */
-            UBYTE repeatCount;
-
-            if (!readBits(bitBuf, 3, &repeatCount))
-            {
-                freeHuffmanTable(&codeLengthTable);
-                return FALSE;
-            }
-            repeatCount += 3;
-
-            for (j = 0; j < repeatCount && i < hdist; j++)
-                distanceLengths[i++] = 0;
-        }
-        else if (decodedValue == 18)
-        {
-            /* Repeat code length 0 for 11-138 times */
-            UBYTE repeatCount;
-
-            if (!readBits(bitBuf, 7, &repeatCount))
-            {
-                freeHuffmanTable(&codeLengthTable);
-                return FALSE;
-            }
-            repeatCount += 11;
+        blCount[codeLengths[i]]++;
 
-            for (j = 0; j < repeatCount && i < hdist; j++)
-                distanceLengths[i++] = 0;
-        }
+        /* Find the maximum bit length */
+        if (codeLengths[i] > maxBits)
+            maxBits = codeLengths[i];
     }
 
-    fileLoggerAddDebugEntry("Decoded literal/length and distance code lengths");
-
-    /* Build Huffman trees for literals/lengths and distances */
-    HuffmanTable literalTable, distanceTable;
+    blCount[0] = 0;
+    table->maxBits = maxBits;
 
-    if (!buildHuffmanTreeFromCodeLengths(literalLengths, hlit, &literalTable))
+    /* Reject bad sets in O(MAX_BITS) before any table memory is touched */
+    table->status = checkHuffmanCodeCounts(blCount);
+    if (table->status != HUFFMAN_CODES_COMPLETE)
     {
-        fileLoggerAddDebugEntry("Failed to build Huffman tree for literals/lengths");
-        freeHuffmanTable(&codeLengthTable);
+        LOG_DEBUG(table->status == HUFFMAN_CODES_OVERSUBSCRIBED ? "Over-subscribed Huffman code lengths"
+                                                                : "Incomplete Huffman code lengths");
         return FALSE;
     }
 
-    if (!buildHuffmanTreeFromCodeLengths(distanceLengths, hdist, &distanceTable))
-    {
-        fileLoggerAddDebugEntry("Failed to build Huffman tree for distances");
-        freeHuffmanTable(&codeLengthTable);
-        freeHuffmanTable(&literalTable);
-        return FALSE;
-    }
+    /* Literal/length tables get a wider primary table than the small
+     * distance and code length alphabets */
+    rootBits = (numCodes > MAX_DISTANCE_CODES) ? HUFFMAN_LITERAL_ROOT_BITS : HUFFMAN_DISTANCE_ROOT_BITS;
+    if (rootBits > maxBits)
+        rootBits = maxBits;
+    if (rootBits == 0)
+        rootBits = 1; /* Keep an (all invalid) table for empty code sets */
 
-    // fileLoggerAddDebugEntry("Built Huffman trees for literals/lengths and distances");
+    table->rootBits = rootBits;
+    rootSize = 1UL << rootBits;
 
-    /* Use these trees to decode the actual compressed data (literals and length/distance pairs) */
-    if (!decodeLZ77Data(bitBuf, &literalTable, &distanceTable, outputBuffer, outputBufferSize, outPos))
+    /* Find the numerical value of the smallest code for each bit length */
+    code = 0;
+    nextCode[0] = 0;
+    for (i = 1; i <= MAX_BITS; i++)
     {
-        fileLoggerAddDebugEntry("Failed to decode LZ77 compressed data");
-        freeHuffmanTable(&codeLengthTable);
-        freeHuffmanTable(&literalTable);
-        freeHuffmanTable(&distanceTable);
-        return FALSE;
+        code = (code + blCount[i - 1]) << 1;
+        nextCode[i] = code;
     }
 
-    fileLoggerAddDebugEntry("Successfully decoded LZ77 compressed data");
-
-    /* Clean up */
-    freeHuffmanTable(&codeLengthTable);
-    freeHuffmanTable(&literalTable);
-    freeHuffmanTable(&distanceTable);
+    /* First pass: size the sub-table hanging off each root prefix */
+    for (i = 0; i < rootSize; i++)
+        subTableBits[i] = 0;
 
-    return TRUE;
-}
-
-/* Build a Huffman tree from code lengths according to RFC 1951
- * This algorithm constructs canonical Huffman codes from code lengths
- */
-BOOL buildHuffmanTreeFromCodeLengths(UBYTE *codeLengths, ULONG numCodes, HuffmanTable *table)
-{
-    ULONG i;
-    ULONG code = 0;
-    UBYTE maxBits = 0;
-    ULONG *blCount = NULL;
-    ULONG *nextCode = NULL;
-    char logMessage[256];
-
-    if (!codeLengths || !table)
+    for (i = 0; i < numCodes; i++)
     {
-        fileLoggerAddDebugEntry("Invalid parameters for buildHuffmanTreeFromCodeLengths");
-        return FALSE;
+        UBYTE len = codeLengths[i];
+        if (len > rootBits)
+        {
+            UWORD prefix = reverseHuffmanCode(nextCode[len], len) & (rootSize - 1);
+            if (len - rootBits > subTableBits[prefix])
+                subTableBits[prefix] = len - rootBits;
+        }
+        if (len > 0)
+            nextCode[len]++;
     }
 
-    /* Allocate the nodes array */
-    table->maxCodes = numCodes;
-    table->nodes = (HuffmanNode *)malloc(numCodes * sizeof(HuffmanNode));
-    if (!table->nodes)
+    numEntries = rootSize;
+    for (i = 0; i < rootSize; i++)
     {
-        fileLoggerAddDebugEntry("Failed to allocate memory for Huffman nodes");
-        return FALSE;
+        if (subTableBits[i] > 0)
+            numEntries += 1UL << subTableBits[i];
     }
 
-    /* Initialize all nodes */
-    for (i = 0; i < numCodes; i++)
+    /* The primary table and all sub-tables live in one block */
+    table->numEntries = numEntries;
+    if (storage)
     {
-        table->nodes[i].value = i;
-        table->nodes[i].bits = codeLengths[i];
-        table->nodes[i].code = 0;
-
-        /* Find the maximum bit length */
-        if (codeLengths[i] > maxBits)
-            maxBits = codeLengths[i];
+        if (numEntries > storageSize)
+        {
+            LOG_DEBUGF(logMessage, "Huffman lookup table needs %lu entries, only %lu available", numEntries, storageSize);
+            return FALSE;
+        }
+        table->entries = storage;
     }
-
-    table->maxBits = maxBits;
-
-    /* Allocate temporary arrays for counting and generating codes */
-    blCount = (ULONG *)malloc((maxBits + 1) * sizeof(ULONG));
-    nextCode = (ULONG *)malloc((maxBits + 1) * sizeof(ULONG));
-
-    if (!blCount || !nextCode)
+    else
     {
-        fileLoggerAddDebugEntry("Failed to allocate memory for Huffman code generation");
-        free(blCount);
-        free(nextCode);
-        free(table->nodes);
-        table->nodes = NULL;
-        return FALSE;
+        table->entries = (HuffmanEntry *)malloc(numEntries * sizeof(HuffmanEntry));
+        if (!table->entries)
+        {
+            LOG_DEBUG("Failed to allocate memory for Huffman lookup table");
+            return FALSE;
+        }
+        table->allocated = TRUE;
     }
 
-    /* Initialize arrays */
-    for (i = 0; i <= maxBits; i++)
-    {
-        blCount[i] = 0;
-        nextCode[i] = 0;
-    }
+    memset(table->entries, 0, numEntries * sizeof(HuffmanEntry));
 
-    /* Count the number of codes for each bit length */
-    for (i = 0; i < numCodes; i++)
+    /* Link root entries to their sub-tables */
+    numEntries = rootSize;
+    for (i = 0; i < rootSize; i++)
     {
-        if (codeLengths[i] > 0)
-            blCount[codeLengths[i]]++;
+        if (subTableBits[i] > 0)
+        {
+            table->entries[i].value = numEntries;
+            table->entries[i].bits = subTableBits[i];
+            table->entries[i].flags = HUFFMAN_ENTRY_SUBTABLE;
+            numEntries += 1UL << subTableBits[i];
+        }
     }
 
-    /* Find the numerical value of the smallest code for each bit length */
+    /* Second pass: assign codes to each symbol according to bit lengths and
+     * replicate them into every table slot whose low bits match the code */
     code = 0;
-    for (i = 1; i <= maxBits; i++)
+    for (i = 1; i <= MAX_BITS; i++)
     {
         code = (code + blCount[i - 1]) << 1;
         nextCode[i] = code;
     }
 
-    /* Assign codes to each symbol according to bit lengths */
     for (i = 0; i < numCodes; i++)
     {
         UBYTE len = codeLengths[i];
-        if (len > 0)
+        UWORD reversed;
+
+        if (len == 0)
+            continue;
+
+        reversed = reverseHuffmanCode(nextCode[len]++, len);
+
+        if (len <= rootBits)
         {
-            table->nodes[i].code = nextCode[len];
-            nextCode[len]++;
+            for (j = reversed; j < rootSize; j += 1UL << len)
+            {
+                entry = &table->entries[j];
+                entry->value = i;
+                entry->bits = len;
+                entry->flags = HUFFMAN_ENTRY_SYMBOL;
+            }
         }
-    }
+        else
+        {
+            HuffmanEntry *link = &table->entries[reversed & (rootSize - 1)];
+            ULONG subSize = 1UL << link->bits;
 
-    /* Clean up temporary arrays */
-    free(blCount);
-    free(nextCode);
+            for (j = reversed >> rootBits; j < subSize; j += 1UL << (len - rootBits))
+            {
+                entry = &table->entries[link->value + j];
+                entry->value = i;
+                entry->bits = len - rootBits;
+                entry->flags = HUFFMAN_ENTRY_SYMBOL;
+            }
+        }
+    }
 
-    // sprintf(logMessage, "Built Huffman tree with %lu codes, max bits: %u", numCodes, maxBits);
-    // fileLoggerAddDebugEntry(logMessage);
+    LOG_TRACEF(logMessage, "Built Huffman table with %lu codes, max bits: %u, entries: %lu", numCodes, maxBits, numEntries);
 
     return TRUE;
 }
 
-/* Decode a single value using a Huffman table */
+/* Decode a single value using a Huffman table
+ * One probe of the primary table resolves every code of up to rootBits
+ * bits; longer codes take one more probe into their sub-table */
 BOOL decodeHuffmanValue(BitBuffer *bitBuf, HuffmanTable *table, UWORD *value)
 {
-    ULONG code = 0;
-    UBYTE len = 0;
-    ULONG i;
-    UBYTE bit;
-    char logMessage[256];
+    const HuffmanEntry *entry;
+    ULONG bits;
+    UBYTE used = 0;
 
-    /* Read bits one at a time and try to find a matching code */
-    while (len <= table->maxBits)
+    if (!table->entries)
     {
-        /* Get next bit */
-        if (!readBits(bitBuf, 1, &bit))
-        {
-            fileLoggerAddDebugEntry("Failed to read bit from buffer");
-            return FALSE;
-        }
+        LOG_DEBUG("Failed to decode Huffman value: empty table");
+        return FALSE;
+    }
 
-        /* Append bit to the code, MSB first */
-        code = (code << 1) | bit;
-        len++;
+    bits = peekBits(bitBuf, MAX_BITS);
+    entry = &table->entries[bits & ((1UL << table->rootBits) - 1)];
 
-        /* Search for matching code in the table */
-        for (i = 0; i < table->maxCodes; i++)
-        {
-            if (table->nodes[i].bits == len && table->nodes[i].code == code)
-            {
-                /* Found a match */
-                *value = table->nodes[i].value;
+    if (entry->flags & HUFFMAN_ENTRY_SUBTABLE)
+    {
+        used = table->rootBits;
+        entry = &table->entries[entry->value + ((bits >> used) & ((1UL << entry->bits) - 1))];
+    }
 
-                return TRUE;
-            }
-        }
+    if (!(entry->flags & HUFFMAN_ENTRY_SYMBOL))
+    {
+        LOG_DEBUG("Failed to decode Huffman value: invalid code");
+        return FALSE;
     }
 
-    /* Exceeded max bits without finding a valid code */
-    sprintf(logMessage, "Failed to decode Huffman value after %u bits", len);
-    fileLoggerAddDebugEntry(logMessage);
+    if (!consumeBits(bitBuf, used + entry->bits))
+    {
+        LOG_DEBUG("Failed to decode Huffman value: out of input");
+        return FALSE;
+    }
 
-    return FALSE;
+    *value = entry->value;
+    return TRUE;
 }
 
 /* Free resources allocated for a Huffman table */
 void freeHuffmanTable(HuffmanTable *table)
 {
-    if (table && table->nodes)
+    if (table && table->entries)
     {
-        free(table->nodes);
-        table->nodes = NULL;
+        if (table->allocated)
+            free(table->entries);
+        table->entries = NULL;
+        table->allocated = FALSE;
         table->maxBits = 0;
         table->maxCodes = 0;
+        table->numEntries = 0;
     }
 }
 
-/* Decode LZ77 compressed data using Huffman tables
- * This function decodes the actual compressed data using the provided Huffman tables
- * It implements LZ77 decompression with variable-length backreferences
- * according to RFC 1951 (DEFLATE) specification
- */
-BOOL decodeLZ77Data(BitBuffer *bitBuf, HuffmanTable *literalTable, HuffmanTable *distanceTable,
-                    UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos)
+/* Copy an LZ77 match of 'length' bytes from 'distance' bytes back
+ * The caller has already checked both ends of the match against the buffer.
+ * Sources that overlap the destination repeat with period 'distance', so
+ * the copy is done in non-overlapping memcpy blocks that double in size
+ * as more of the pattern is written. memcpy moves whole longwords when the
+ * pointers allow it, and unlike a direct ULONG access it is safe on the
+ * 68000 with odd addresses */
+void copyLZ77Match(UBYTE *dest, ULONG distance, ULONG length)
 {
-    UWORD code;
-    ULONG length, distance;
-    ULONG i, j;
-    UBYTE extraBits;
-    char logMessage[256];
+    UBYTE *src = dest - distance;
+    ULONG chunk;
 
-    /* Keep decoding until we find the end-of-block marker (256) */
-    while (1)
+    if (length < LZ77_SHORT_MATCH)
     {
-        /* Decode a literal/length value using the literal/length Huffman table */
-        if (!decodeHuffmanValue(bitBuf, literalTable, &code))
-        {
-            fileLoggerAddDebugEntry("Failed to decode literal/length value");
-            return FALSE;
-        }
-
-        if (code < 256)
-        {
-            /* Literal byte */
-            if (*outPos >= outputBufferSize)
-            {
-                fileLoggerAddDebugEntry("Output buffer overflow when writing literal");
-                return FALSE;
-            }
-
-            /* Write the literal byte to the output */
-            outputBuffer[(*outPos)++] = (UBYTE)code;
-        }
-        else if (code == 256)
-        {
-            /* End of block */
-            fileLoggerAddDebugEntry("End of block marker found");
-            return TRUE;
-        }
-        else if (code <= 285)
-        {
-            /* Length/distance pair (backreference) */
-            ULONG lengthCode = code - 257;
-
-            /* Get base length for this code */
-            if (lengthCode >= 29)
-            {
-                sprintf(logMessage, "Invalid length code: %lu", lengthCode);
-                fileLoggerAddDebugEntry(logMessage);
-                return FALSE;
-            }
-
-            /* Start with the base length */
-            length = lengthBase[lengthCode];
-
-            /* Read extra bits if needed */
-            extraBits = lengthExtraBits[lengthCode];
-            if (extraBits > 0)
-            {
-                UBYTE extraBitsValue;
-
-                for (i = 0; i < extraBits; i++)
-                {
-                    if (!readBits(bitBuf, 1, &extraBitsValue))
-                    {
-                        fileLoggerAddDebugEntry("Failed to read length extra bits");
-                        return FALSE;
-                    }
-                    length += extraBitsValue << i;
-                }
-            }
-
-            /* Decode the distance code */
-            if (!decodeHuffmanValue(bitBuf, distanceTable, &code))
-            {
-                fileLoggerAddDebugEntry("Failed to decode distance value");
-                return FALSE;
-            }
-
-            /* Distance code must be in range 0-29 */
-            if (code >= 30)
-            {
-                sprintf(logMessage, "Invalid distance code: %u", code);
-                fileLoggerAddDebugEntry(logMessage);
-                return FALSE;
-            }
-
-            /* Start with the base distance */
-            distance = distanceBase[code];
-
-            /* Read extra bits if needed */
-            extraBits = distanceExtraBits[code];
-            if (extraBits > 0)
-            {
-                UBYTE extraBitsValue;
-
-                for (i = 0; i < extraBits; i++)
-                {
-                    if (!readBits(bitBuf, 1, &extraBitsValue))
-                    {
-                        fileLoggerAddDebugEntry("Failed to read distance extra bits");
-                        return FALSE;
-                    }
-                    distance += extraBitsValue << i;
-                }
-            }
-
-            /* Validate the backreference */
-            if (distance > *outPos)
-            {
-                fileLoggerAddDebugEntry("Invalid backreference: distance larger than output position");
-                return FALSE;
-            }
-
-            if (*outPos + length > outputBufferSize)
-            {
-                char sizeMessage[256];
-                sprintf(sizeMessage, "Output buffer overflow when copying backreference: outPos=%lu, length=%lu, buffer size=%lu",
-                        *outPos, length, outputBufferSize);
-                fileLoggerAddDebugEntry(sizeMessage);
-                return FALSE;
-            }
-
-            /* Copy the referenced bytes */
-            for (i = 0; i < length; i++)
-            {
-                outputBuffer[*outPos] = outputBuffer[*outPos - distance];
-                (*outPos)++;
-            }
-        }
-        else
+        /* Too short to be worth a library call; a forward byte copy is
+         * correct for any overlap */
+        while (length--)
+            *dest++ = *src++;
+    }
+    else if (distance == 1)
+    {
+        /* Run of a single byte */
+        memset(dest, *src, length);
+    }
+    else if (distance >= length)
+    {
+        /* No overlap */
+        memcpy(dest, src, length);
+    }
+    else
+    {
+        /* Replicate the pattern, doubling the block each time */
+        chunk = distance;
+        while (length > chunk)
         {
-            /* Invalid code (codes 286-287 are reserved) */
-            sprintf(logMessage, "Invalid literal/length code: %u", code);
-            fileLoggerAddDebugEntry(logMessage);
-            return FALSE;
+            memcpy(dest, src, chunk);
+            dest += chunk;
+            length -= chunk;
+            chunk <<= 1;
         }
+        memcpy(dest, src, length);
     }
-
-    /* We should never reach here because we return when we find the end-of-block marker */
-    return FALSE;
 }
 
-/* Process a fixed Huffman (type 1) DEFLATE block
+/* Fixed Huffman tables, shared read-only by every fixed block */
+static HuffmanEntry fixedLiteralEntries[1 << HUFFMAN_LITERAL_ROOT_BITS];
+static HuffmanEntry fixedDistanceEntries[1 << FIXED_DISTANCE_BITS];
+static HuffmanTable fixedLiteralTable;
+static HuffmanTable fixedDistanceTable;
+static BOOL fixedTablesReady = FALSE;
+
+/* Get the fixed Huffman tables, building them on first use
  * According to RFC 1951, the fixed Huffman codes are defined as follows:
  * Literal/length alphabet:
  *   - Literals 0-143: 8 bits, codes 00110000 through 10111111
@@ -588,70 +423,45 @@ BOOL decodeLZ77Data(BitBuffer *bitBuf, HuffmanTable *literalTable, HuffmanTable
  *   - Literals 256-279: 7 bits, codes 0000000 through 0010111
  *   - Literals 280-287: 8 bits, codes 11000000 through 11000111
  * Distance alphabet:
- *   - All 30 codes are 5 bits, codes 00000 through 11101
+ *   - All 32 codes are 5 bits, codes 00000 through 11111 (30 and 31 never occur)
+ * Every code is at most 9 bits, so both tables are a single primary table
+ * held in static storage.
  */
-BOOL processFixedHuffmanBlock(BitBuffer *bitBuf, UBYTE *compressedData, ULONG compressedSize,
-                              UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos)
+BOOL getFixedHuffmanTables(HuffmanTable **literalTable, HuffmanTable **distanceTable)
 {
-    char logMessage[256];
-    HuffmanTable literalTable, distanceTable;
-    UBYTE literalLengths[MAX_LITERAL_CODES];
-    UBYTE distanceLengths[MAX_DISTANCE_CODES];
+    UBYTE literalLengths[FIXED_LITERAL_CODES];
+    UBYTE distanceLengths[FIXED_DISTANCE_CODES];
     ULONG i;
 
-    fileLoggerAddDebugEntry("Processing fixed Huffman block");
-
-    /* Initialize code lengths for fixed Huffman codes */
-    /* Literals 0-143: 8 bits */
-    for (i = 0; i <= 143; i++)
-        literalLengths[i] = 8;
-
-    /* Literals 144-255: 9 bits */
-    for (i = 144; i <= 255; i++)
-        literalLengths[i] = 9;
-
-    /* Literals 256-279: 7 bits */
-    for (i = 256; i <= 279; i++)
-        literalLengths[i] = 7;
-
-    /* Literals 280-287: 8 bits */
-    for (i = 280; i < MAX_LITERAL_CODES; i++)
-        literalLengths[i] = 8;
-
-    /* All 30 distance codes are 5 bits */
-    for (i = 0; i < MAX_DISTANCE_CODES; i++)
-        distanceLengths[i] = 5;
-
-    /* Build Huffman trees for literals/lengths and distances */
-    if (!buildHuffmanTreeFromCodeLengths(literalLengths, MAX_LITERAL_CODES, &literalTable))
-    {
-        fileLoggerAddDebugEntry("Failed to build fixed Huffman tree for literals/lengths");
-        return FALSE;
-    }
-
-    if (!buildHuffmanTreeFromCodeLengths(distanceLengths, MAX_DISTANCE_CODES, &distanceTable))
+    if (!fixedTablesReady)
     {
-        fileLoggerAddDebugEntry("Failed to build fixed Huffman tree for distances");
-        freeHuffmanTable(&literalTable);
-        return FALSE;
-    }
-
-    fileLoggerAddDebugEntry("Built fixed Huffman trees for literals/lengths and distances");
+        /* Initialize code lengths for fixed Huffman codes */
+        for (i = 0; i <= 143; i++)
+            literalLengths[i] = 8;
+        for (i = 144; i <= 255; i++)
+            literalLengths[i] = 9;
+        for (i = 256; i <= 279; i++)
+            literalLengths[i] = 7;
+        for (i = 280; i < FIXED_LITERAL_CODES; i++)
+            literalLengths[i] = 8;
+
+        for (i = 0; i < FIXED_DISTANCE_CODES; i++)
+            distanceLengths[i] = FIXED_DISTANCE_BITS;
+
+        if (!buildHuffmanTableInto(literalLengths, FIXED_LITERAL_CODES, &fixedLiteralTable,
+                                   fixedLiteralEntries, 1 << HUFFMAN_LITERAL_ROOT_BITS) ||
+            !buildHuffmanTableInto(distanceLengths, FIXED_DISTANCE_CODES, &fixedDistanceTable,
+                                   fixedDistanceEntries, 1 << FIXED_DISTANCE_BITS))
+        {
+            LOG_DEBUG("Failed to build fixed Huffman tables");
+            return FALSE;
+        }
 
-    /* Use these trees to decode the actual compressed data */
-    if (!decodeLZ77Data(bitBuf, &literalTable, &distanceTable, outputBuffer, outputBufferSize, outPos))
-    {
-        fileLoggerAddDebugEntry("Failed to decode fixed Huffman LZ77 compressed data");
-        freeHuffmanTable(&literalTable);
-        freeHuffmanTable(&distanceTable);
-        return FALSE;
+        fixedTablesReady = TRUE;
+        LOG_DEBUG("Built fixed Huffman tables for literals/lengths and distances");
     }
 
-    fileLoggerAddDebugEntry("Successfully decoded fixed Huffman LZ77 compressed data");
-
-    /* Clean up */
-    freeHuffmanTable(&literalTable);
-    freeHuffmanTable(&distanceTable);
-
+    *literalTable = &fixedLiteralTable;
+    *distanceTable = &fixedDistanceTable;
     return TRUE;
 }
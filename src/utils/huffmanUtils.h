@@ -16,47 +16,79 @@
 #define MAX_CODE_LENGTHS 19
 #define END_OF_BLOCK 256
 
-/* Huffman tree node structure */
-typedef struct HuffmanNode
+/* Fixed Huffman code (block type 1) alphabet sizes, RFC 1951 3.2.6 */
+#define FIXED_LITERAL_CODES 288
+#define FIXED_DISTANCE_CODES 32
+#define FIXED_DISTANCE_BITS 5
+
+/* Index width of the primary lookup table. Codes longer than this
+ * continue into a sub-table, so every symbol costs one or two probes */
+#define HUFFMAN_LITERAL_ROOT_BITS 9
+#define HUFFMAN_DISTANCE_ROOT_BITS 6
+
+/* LZ77 matches shorter than this are copied a byte at a time */
+#define LZ77_SHORT_MATCH 8
+
+/* Lookup table entry flags */
+#define HUFFMAN_ENTRY_INVALID 0x00  /* No code maps to this index */
+#define HUFFMAN_ENTRY_SYMBOL 0x01   /* Entry holds a decoded symbol */
+#define HUFFMAN_ENTRY_SUBTABLE 0x02 /* Entry links to a sub-table for long codes */
+
+/* Code length set status reported in HuffmanTable.status */
+#define HUFFMAN_CODES_COMPLETE 0       /* Every code is used exactly once (or at most one code) */
+#define HUFFMAN_CODES_OVERSUBSCRIBED 1 /* More codes than the lengths can represent */
+#define HUFFMAN_CODES_INCOMPLETE 2     /* Some codes are left unused */
+
+/* Huffman lookup table entry */
+typedef struct HuffmanEntry
 {
-    UWORD value; /* Value to output (literal, length, or distance) */
-    UBYTE bits;  /* Number of bits in the code */
-    ULONG code;  /* The Huffman code */
-} HuffmanNode;
+    UWORD value; /* Decoded symbol, or offset of the sub-table */
+    UBYTE bits;  /* Bits to consume for a symbol, or sub-table index width */
+    UBYTE flags; /* HUFFMAN_ENTRY_* */
+} HuffmanEntry;
 
-/* Huffman code table structure */
+/* Huffman code table structure
+ * The primary table is indexed by the next rootBits bits of the stream
+ * (LSB first); sub-tables for longer codes follow it in the same array */
 typedef struct HuffmanTable
 {
-    UWORD maxCodes;     /* Maximum number of codes in the table */
-    UBYTE maxBits;      /* Maximum bit length for codes */
-    HuffmanNode *nodes; /* Array of Huffman nodes */
+    UWORD maxCodes;        /* Maximum number of codes in the table */
+    UBYTE maxBits;         /* Maximum bit length for codes */
+    UBYTE rootBits;        /* Index width of the primary table */
+    UWORD numEntries;      /* Primary table plus all sub-tables */
+    HuffmanEntry *entries; /* Lookup table entries */
+    BOOL allocated;        /* Whether we allocated memory for entries */
+    UBYTE status;          /* HUFFMAN_CODES_* found by the last build */
 } HuffmanTable;
 
-/* Process a dynamic Huffman (type 2) DEFLATE block */
-BOOL processDynamicHuffmanBlock(BitBuffer *bitBuf, UBYTE *compressedData, ULONG compressedSize,
-                                UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos);
-
-/* Process a fixed Huffman (type 1) DEFLATE block */
-BOOL processFixedHuffmanBlock(BitBuffer *bitBuf, UBYTE *compressedData, ULONG compressedSize,
-                              UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos);
-
 /* Get the code length code order for dynamic Huffman decoding */
 const UBYTE *getCodeLengthCodeOrder(void);
 
+/* Get the LZ77 length and distance base/extra-bit tables (RFC 1951 3.2.5) */
+const UWORD *getLengthBase(void);
+const UBYTE *getLengthExtraBits(void);
+const UWORD *getDistanceBase(void);
+const UBYTE *getDistanceExtraBits(void);
+
 /* Build a Huffman tree from code lengths */
 BOOL buildHuffmanTreeFromCodeLengths(UBYTE *codeLengths, ULONG numCodes, HuffmanTable *table);
 
+/* Build a Huffman lookup table into caller-provided storage (or allocate it when storage is NULL)
+ * Over-subscribed and incomplete code sets are rejected before the table
+ * is touched, with the reason left in table->status */
+BOOL buildHuffmanTableInto(UBYTE *codeLengths, ULONG numCodes, HuffmanTable *table,
+                           HuffmanEntry *storage, ULONG storageSize);
+
+/* Get the shared fixed Huffman tables, building them on first use */
+BOOL getFixedHuffmanTables(HuffmanTable **literalTable, HuffmanTable **distanceTable);
+
 /* Decode a single value using a Huffman table */
 BOOL decodeHuffmanValue(BitBuffer *bitBuf, HuffmanTable *table, UWORD *value);
 
 /* Free resources allocated for a Huffman table */
 void freeHuffmanTable(HuffmanTable *table);
 
-/* Decode LZ77 compressed data using Huffman tables */
-BOOL decodeLZ77Data(BitBuffer *bitBuf, HuffmanTable *literalTable, HuffmanTable *distanceTable,
-                    UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos);
-
-/* Free resources allocated for a Huffman table */
-void freeHuffmanTable(HuffmanTable *table);
+/* Copy an LZ77 match of length bytes from distance bytes back (bounds already checked) */
+void copyLZ77Match(UBYTE *dest, ULONG distance, ULONG length);
 
 #endif /* HUFFMAN_UTILS_H */
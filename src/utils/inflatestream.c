@@ -0,0 +1,1107 @@
+/*
+ * Streaming DEFLATE/zlib/gzip decompression for AmigaOS 3.1
+ * Decodes compressed data supplied in arbitrary slices into
+ * caller-provided output slices, keeping only a 32 KB window resident
+ *
+ * The decoder is a state machine in the style of zlib's inflate(): every
+ * state only consumes input once everything it needs is buffered, so a
+ * call can stop at any slice boundary and resume on the next call.
+ * Output goes straight into the caller's slice; back-references that
+ * reach past the start of the slice are served from the window, which is
+ * refreshed with each call's output before returning. The Adler-32 (or
+ * the CRC-32 of a gzip member) is updated over the same span while it is still in the cache, so the
+ * output is never walked a second time to verify it.
+ * Dynamic block tables are built into the workspace allocated with the
+ * window, so decoding itself never touches the heap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include "inflatestream.h"
+#include "crc32utils.h"
+#include "filelogger.h"
+
+/* Decoder states */
+#define INFLATE_MODE_ZLIB_HEADER 0     /* 2-byte zlib header */
+#define INFLATE_MODE_DICTID 1          /* Preset dictionary ID */
+#define INFLATE_MODE_GZIP_HEADER 2     /* Fixed 10-byte gzip member header */
+#define INFLATE_MODE_GZIP_EXTRA 3      /* gzip FEXTRA length and field */
+#define INFLATE_MODE_GZIP_STRINGS 4    /* gzip FNAME and FCOMMENT, zero-terminated */
+#define INFLATE_MODE_GZIP_HEADER_CRC 5 /* gzip FHCRC */
+#define INFLATE_MODE_BLOCK_HEADER 6    /* BFINAL and BTYPE */
+#define INFLATE_MODE_STORED_LENGTH 7   /* Stored block LEN */
+#define INFLATE_MODE_STORED_CHECK 8    /* Stored block NLEN */
+#define INFLATE_MODE_STORED_COPY 9     /* Stored block data */
+#define INFLATE_MODE_TABLE_COUNTS 10   /* HLIT, HDIST and HCLEN */
+#define INFLATE_MODE_CODELEN_LENS 11   /* Code length code lengths */
+#define INFLATE_MODE_CODE_LENGTHS 12   /* Literal/length and distance code lengths */
+#define INFLATE_MODE_LENGTH 13         /* Literal/length symbol */
+#define INFLATE_MODE_LITERAL 14        /* Literal waiting for output space */
+#define INFLATE_MODE_LENGTH_EXTRA 15   /* Length extra bits */
+#define INFLATE_MODE_DISTANCE 16       /* Distance symbol */
+#define INFLATE_MODE_DISTANCE_EXTRA 17 /* Distance extra bits */
+#define INFLATE_MODE_COPY 18           /* Match copy waiting for output space */
+#define INFLATE_MODE_CHECK 19          /* Adler-32 trailer */
+#define INFLATE_MODE_GZIP_TRAILER 20   /* gzip CRC-32 and ISIZE */
+#define INFLATE_MODE_DONE 21           /* Stream finished */
+#define INFLATE_MODE_BAD 22            /* Stream failed */
+
+/* gzip header FLG bits (RFC 1952) */
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+#define GZIP_FLAG_RESERVED 0xE0
+
+/* Results of streamDecodeSymbol */
+#define STREAM_SYMBOL_OK 0
+#define STREAM_SYMBOL_NEED_INPUT 1
+#define STREAM_SYMBOL_INVALID 2
+
+/* Fast loop limits: the longest match, and enough input for three
+ * accumulator refills (length code, distance code, distance extra bits) */
+#define INFLATE_FAST_MIN_OUTPUT 258
+#define INFLATE_FAST_MIN_INPUT 12
+
+/* No code length symbol is waiting for its extra bits */
+#define NO_LENGTH_SYMBOL 0xFFFF
+
+/* Make sure numBits bits are buffered, pulling from the input slice */
+static BOOL streamHaveBits(BitBuffer *bitBuf, UBYTE numBits)
+{
+    if (bitBuf->bitsAvail < numBits)
+        refillBitBuffer(bitBuf);
+
+    return bitBuf->bitsAvail >= numBits;
+}
+
+/* Decode one Huffman symbol if its whole code is buffered
+ * A code that looks invalid only because bits are missing is reported as
+ * needing input; it is caught as invalid once the bits arrive */
+static UBYTE streamDecodeSymbol(BitBuffer *bitBuf, HuffmanTable *table, UWORD *value)
+{
+    const HuffmanEntry *entry;
+    ULONG bits;
+    UBYTE used = 0;
+
+    bits = peekBits(bitBuf, MAX_BITS);
+    entry = &table->entries[bits & ((1UL << table->rootBits) - 1)];
+
+    if (entry->flags & HUFFMAN_ENTRY_SUBTABLE)
+    {
+        used = table->rootBits;
+        entry = &table->entries[entry->value + ((bits >> used) & ((1UL << entry->bits) - 1))];
+    }
+
+    if (!(entry->flags & HUFFMAN_ENTRY_SYMBOL))
+        return (bitBuf->bitsAvail < table->maxBits) ? STREAM_SYMBOL_NEED_INPUT : STREAM_SYMBOL_INVALID;
+
+    if (used + entry->bits > bitBuf->bitsAvail)
+        return STREAM_SYMBOL_NEED_INPUT;
+
+    consumeBits(bitBuf, used + entry->bits);
+    *value = entry->value;
+    return STREAM_SYMBOL_OK;
+}
+
+/* Fold the output produced since outStart into the window and checksum */
+static void accountStreamOutput(InflateStream *stream)
+{
+    ULONG produced = stream->nextOut - stream->outStart;
+    UBYTE *source = stream->outStart;
+    ULONG chunk;
+
+    if (produced == 0)
+        return;
+
+    stream->totalOut += produced;
+    if (stream->verifyChecksum)
+    {
+        if (stream->format == INFLATE_FORMAT_ZLIB)
+            stream->checksum = adler32Update(stream->checksum, source, produced);
+        else if (stream->format == INFLATE_FORMAT_GZIP)
+            stream->checksum = crc32Update(stream->checksum, source, produced);
+    }
+
+    /* Only the last window's worth of output can ever be referenced */
+    if (produced >= INFLATE_WINDOW_SIZE)
+    {
+        memcpy(stream->window, source + produced - INFLATE_WINDOW_SIZE, INFLATE_WINDOW_SIZE);
+        stream->windowPos = 0;
+        stream->windowHave = INFLATE_WINDOW_SIZE;
+    }
+    else
+    {
+        chunk = INFLATE_WINDOW_SIZE - stream->windowPos;
+        if (chunk > produced)
+            chunk = produced;
+
+        memcpy(stream->window + stream->windowPos, source, chunk);
+        if (produced > chunk)
+            memcpy(stream->window, source + chunk, produced - chunk);
+
+        stream->windowPos = (stream->windowPos + produced) & INFLATE_WINDOW_MASK;
+        stream->windowHave += produced;
+        if (stream->windowHave > INFLATE_WINDOW_SIZE)
+            stream->windowHave = INFLATE_WINDOW_SIZE;
+    }
+
+    stream->outStart = stream->nextOut;
+}
+
+/* Drop the current block's tables; dynamic ones live in the workspace */
+static void endStreamBlock(InflateStream *stream)
+{
+    stream->currentLiterals = NULL;
+    stream->currentDistances = NULL;
+}
+
+/* Copy as much of the pending match as fits in the output slice */
+static void copyStreamMatch(InflateStream *stream)
+{
+    while (stream->length > 0 && stream->availOut > 0)
+    {
+        ULONG produced = stream->nextOut - stream->outStart;
+        ULONG count = stream->length;
+
+        if (count > stream->availOut)
+            count = stream->availOut;
+
+        if (stream->distance > produced)
+        {
+            /* Source starts in the window; copy up to its end or the
+             * point where the match reaches this call's output */
+            ULONG back = stream->distance - produced;
+            ULONG windowIndex = (stream->windowPos - back) & INFLATE_WINDOW_MASK;
+
+            if (count > back)
+                count = back;
+            if (count > INFLATE_WINDOW_SIZE - windowIndex)
+                count = INFLATE_WINDOW_SIZE - windowIndex;
+
+            memcpy(stream->nextOut, stream->window + windowIndex, count);
+            stream->nextOut += count;
+        }
+        else
+        {
+            /* Source is in this call's output and may overlap the destination */
+            copyLZ77Match(stream->nextOut, stream->distance, count);
+            stream->nextOut += count;
+        }
+
+        stream->availOut -= count;
+        stream->length -= count;
+    }
+}
+
+/* Decode literals and matches without per-symbol space checks
+ * Runs while at least INFLATE_FAST_MIN_OUTPUT bytes of output space and
+ * INFLATE_FAST_MIN_INPUT bytes of input remain, which covers the longest
+ * match and the most input one symbol pair can use. Position and bit state
+ * live in locals for the duration. Anything unusual (end of block, a bad
+ * code, a match reaching into the window) is left to the careful loop by
+ * returning with the stream in the matching mode */
+static void inflateStreamFast(InflateStream *stream)
+{
+    BitBuffer *bitBuf = &stream->bitBuf;
+    const HuffmanEntry *literals = stream->currentLiterals->entries;
+    const HuffmanEntry *distances = stream->currentDistances->entries;
+    ULONG literalMask = (1UL << stream->currentLiterals->rootBits) - 1;
+    ULONG distanceMask = (1UL << stream->currentDistances->rootBits) - 1;
+    UBYTE literalRoot = stream->currentLiterals->rootBits;
+    UBYTE distanceRoot = stream->currentDistances->rootBits;
+    const UWORD *lengthBase = getLengthBase();
+    const UBYTE *lengthExtraBits = getLengthExtraBits();
+    const UWORD *distanceBase = getDistanceBase();
+    const UBYTE *distanceExtraBits = getDistanceExtraBits();
+    UBYTE *in = bitBuf->data + bitBuf->pos;
+    UBYTE *inStart = in;
+    UBYTE *inLast = bitBuf->data + bitBuf->size - INFLATE_FAST_MIN_INPUT;
+    UBYTE *out = stream->nextOut;
+    UBYTE *outLast = stream->nextOut + stream->availOut - INFLATE_FAST_MIN_OUTPUT;
+    ULONG hold = bitBuf->bitAccum;
+    ULONG bits = bitBuf->bitsAvail;
+    ULONG bitsStart = bits;
+    const HuffmanEntry *entry;
+    ULONG used, length, distance, extra;
+
+    while (out <= outLast && in <= inLast)
+    {
+        /* Literal/length code plus up to 5 extra bits */
+        while (bits <= BITBUFFER_MAX_BITS)
+        {
+            hold |= (ULONG)*in++ << bits;
+            bits += 8;
+        }
+
+        used = 0;
+        entry = &literals[hold & literalMask];
+        if (entry->flags & HUFFMAN_ENTRY_SUBTABLE)
+        {
+            used = literalRoot;
+            entry = &literals[entry->value + ((hold >> used) & ((1UL << entry->bits) - 1))];
+        }
+
+        if (!(entry->flags & HUFFMAN_ENTRY_SYMBOL))
+            break; /* Reported by the careful loop */
+
+        if (entry->value < 256)
+        {
+            used += entry->bits;
+            hold >>= used;
+            bits -= used;
+            *out++ = (UBYTE)entry->value;
+            continue;
+        }
+
+        if (entry->value == END_OF_BLOCK)
+        {
+            used += entry->bits;
+            hold >>= used;
+            bits -= used;
+            endStreamBlock(stream);
+            stream->mode = INFLATE_MODE_BLOCK_HEADER;
+            break;
+        }
+
+        if (entry->value > 285)
+            break; /* Reported by the careful loop */
+
+        used += entry->bits;
+        hold >>= used;
+        bits -= used;
+
+        length = lengthBase[entry->value - 257];
+        extra = lengthExtraBits[entry->value - 257];
+        if (extra)
+        {
+            length += hold & ((1UL << extra) - 1);
+            hold >>= extra;
+            bits -= extra;
+        }
+
+        /* Distance code, then up to 13 extra bits */
+        while (bits <= BITBUFFER_MAX_BITS)
+        {
+            hold |= (ULONG)*in++ << bits;
+            bits += 8;
+        }
+
+        used = 0;
+        entry = &distances[hold & distanceMask];
+        if (entry->flags & HUFFMAN_ENTRY_SUBTABLE)
+        {
+            used = distanceRoot;
+            entry = &distances[entry->value + ((hold >> used) & ((1UL << entry->bits) - 1))];
+        }
+
+        if (!(entry->flags & HUFFMAN_ENTRY_SYMBOL) || entry->value >= 30)
+        {
+            /* Let the careful loop decode and report the distance */
+            stream->length = length;
+            stream->mode = INFLATE_MODE_DISTANCE;
+            break;
+        }
+
+        used += entry->bits;
+        hold >>= used;
+        bits -= used;
+
+        distance = distanceBase[entry->value];
+        extra = distanceExtraBits[entry->value];
+        if (extra)
+        {
+            while (bits < extra)
+            {
+                hold |= (ULONG)*in++ << bits;
+                bits += 8;
+            }
+            distance += hold & ((1UL << extra) - 1);
+            hold >>= extra;
+            bits -= extra;
+        }
+
+        if (distance <= (ULONG)(out - stream->outStart))
+        {
+            /* Source is in this call's output */
+            copyLZ77Match(out, distance, length);
+            out += length;
+        }
+        else
+        {
+            /* Source reaches into the window; the match always fits, so
+             * the careful copy finishes it in one go */
+            stream->length = length;
+            stream->distance = distance;
+            if (distance > stream->windowHave + (ULONG)(out - stream->outStart))
+            {
+                /* Invalid distance, reported by the careful loop */
+                stream->extraBits = 0;
+                stream->mode = INFLATE_MODE_DISTANCE_EXTRA;
+                break;
+            }
+
+            stream->availOut -= out - stream->nextOut;
+            stream->nextOut = out;
+            copyStreamMatch(stream);
+            out = stream->nextOut;
+        }
+    }
+
+    /* Hand the local state back to the stream */
+    bitBuf->bitCount += (ULONG)(in - inStart) * 8 + bitsStart - bits;
+    bitBuf->pos = in - bitBuf->data;
+    bitBuf->bitAccum = hold;
+    bitBuf->bitsAvail = (UBYTE)bits;
+    stream->availOut -= out - stream->nextOut;
+    stream->nextOut = out;
+}
+
+/* Fail the stream, recording why and where
+ * The stream stays in INFLATE_MODE_BAD, so later calls return at once */
+static ULONG failInflateStream(InflateStream *stream, UBYTE error, const char *message)
+{
+    LOG_DEBUG(message);
+    stream->error = error;
+    stream->errorBitOffset = stream->bitBuf.bitCount;
+    stream->mode = INFLATE_MODE_BAD;
+    accountStreamOutput(stream);
+    return INFLATE_STREAM_ERROR;
+}
+
+/* Map a failed table build to the stream error that explains it */
+static UBYTE getTableBuildError(HuffmanTable *table)
+{
+    switch (table->status)
+    {
+    case HUFFMAN_CODES_OVERSUBSCRIBED:
+        return INFLATE_ERROR_OVERSUBSCRIBED;
+
+    case HUFFMAN_CODES_INCOMPLETE:
+        return INFLATE_ERROR_INCOMPLETE;
+
+    default:
+        return INFLATE_ERROR_BAD_CODE_LENGTHS;
+    }
+}
+
+/* Finish a call: fold this call's output into the window */
+static ULONG leaveInflateStream(InflateStream *stream, ULONG result)
+{
+    accountStreamOutput(stream);
+    return result;
+}
+
+/* Prepare a stream for decoding; allocates the window and table workspace
+ * This is the only allocation the decoder makes */
+BOOL initInflateStream(InflateStream *stream, UBYTE format)
+{
+    if (!stream)
+        return FALSE;
+
+    memset(stream, 0, sizeof(InflateStream));
+
+    stream->workspace = (InflateWorkspace *)malloc(sizeof(InflateWorkspace));
+    if (!stream->workspace)
+    {
+        LOG_DEBUG("Failed to allocate memory for inflate workspace");
+        return FALSE;
+    }
+
+    resetInflateStream(stream, format);
+
+    return TRUE;
+}
+
+/* Start decoding a new stream, keeping the workspace of an initialised one */
+void resetInflateStream(InflateStream *stream, UBYTE format)
+{
+    InflateWorkspace *workspace = stream->workspace;
+
+    memset(stream, 0, sizeof(InflateStream));
+
+    stream->workspace = workspace;
+    stream->window = workspace->window;
+    stream->format = format;
+    stream->lengthSymbol = NO_LENGTH_SYMBOL;
+    stream->verifyChecksum = TRUE;
+
+    switch (format)
+    {
+    case INFLATE_FORMAT_ZLIB:
+        stream->mode = INFLATE_MODE_ZLIB_HEADER;
+        stream->checksum = 1;
+        break;
+    case INFLATE_FORMAT_GZIP:
+        stream->mode = INFLATE_MODE_GZIP_HEADER;
+        stream->checksum = 0;
+        break;
+    default:
+        stream->mode = INFLATE_MODE_BLOCK_HEADER;
+        break;
+    }
+
+    initBitBuffer(&stream->bitBuf, NULL, 0, 0);
+}
+
+/* Enable or disable verification of the zlib Adler-32 or gzip CRC-32
+ * The trailer is still consumed when verification is off */
+void setInflateStreamChecksum(InflateStream *stream, BOOL verify)
+{
+    stream->verifyChecksum = verify;
+}
+
+/* Prime the window with a preset dictionary
+ * Back-references may reach into the dictionary as if it were earlier
+ * output, but it is not part of the output or its Adler-32. Only the last
+ * INFLATE_WINDOW_SIZE bytes of a longer dictionary can be referenced */
+BOOL setInflateStreamDictionary(InflateStream *stream, const UBYTE *dictionary, ULONG length)
+{
+    if (!stream || !stream->window || (!dictionary && length > 0))
+        return FALSE;
+
+    if (length > INFLATE_WINDOW_SIZE)
+    {
+        dictionary += length - INFLATE_WINDOW_SIZE;
+        length = INFLATE_WINDOW_SIZE;
+    }
+
+    memcpy(stream->window, dictionary, length);
+    stream->windowPos = length & INFLATE_WINDOW_MASK;
+    stream->windowHave = length;
+
+    return TRUE;
+}
+
+/* Supply the next slice of compressed input
+ * Bits already pulled into the accumulator from the previous slice are kept */
+void setInflateStreamInput(InflateStream *stream, UBYTE *data, ULONG size)
+{
+    stream->bitBuf.data = data;
+    stream->bitBuf.size = size;
+    stream->bitBuf.pos = 0;
+}
+
+/* Supply the next slice of output space */
+void setInflateStreamOutput(InflateStream *stream, UBYTE *buffer, ULONG size)
+{
+    stream->nextOut = buffer;
+    stream->outStart = buffer;
+    stream->availOut = size;
+}
+
+/* Unconsumed bytes left in the current input slice */
+ULONG getInflateStreamInputLeft(InflateStream *stream)
+{
+    return stream->bitBuf.size - stream->bitBuf.pos;
+}
+
+/* Decode as far as the current slices allow
+ * Returns INFLATE_STREAM_NEED_INPUT when the input slice is exhausted,
+ * INFLATE_STREAM_OUTPUT_FULL when the output slice is full,
+ * INFLATE_STREAM_DONE once the final block (and zlib or gzip trailer) is decoded,
+ * or INFLATE_STREAM_ERROR for corrupt data */
+ULONG inflateStreamProcess(InflateStream *stream)
+{
+    BitBuffer *bitBuf = &stream->bitBuf;
+    const UWORD *lengthBase = getLengthBase();
+    const UBYTE *lengthExtraBits = getLengthExtraBits();
+    const UWORD *distanceBase = getDistanceBase();
+    const UBYTE *distanceExtraBits = getDistanceExtraBits();
+    const UBYTE *codelenCodeOrder = getCodeLengthCodeOrder();
+    char logMessage[256];
+    ULONG value;
+    UWORD symbol;
+    UBYTE status;
+
+    stream->outStart = stream->nextOut;
+
+    for (;;)
+    {
+        switch (stream->mode)
+        {
+        case INFLATE_MODE_ZLIB_HEADER:
+        {
+            UBYTE header[2];
+            UBYTE compressionMethod, compressionInfo, fCheck, compressionLevel;
+            BOOL hasDictionary;
+
+            if (!streamHaveBits(bitBuf, 16))
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+            readBitsWide(bitBuf, 16, &value);
+            header[0] = (UBYTE)value;
+            header[1] = (UBYTE)(value >> 8);
+
+            if (!processZlibHeader(header, 2, &compressionMethod, &compressionInfo,
+                                   &fCheck, &hasDictionary, &compressionLevel))
+                return failInflateStream(stream, INFLATE_ERROR_BAD_HEADER, "Invalid zlib header in stream");
+
+            stream->trailerBytes = 0;
+            stream->storedChecksum = 0;
+            stream->mode = hasDictionary ? INFLATE_MODE_DICTID : INFLATE_MODE_BLOCK_HEADER;
+            break;
+        }
+
+        case INFLATE_MODE_DICTID:
+        {
+            const UBYTE *dictionary;
+            ULONG dictionaryLength;
+
+            /* Adler-32 of the preset dictionary, stored big-endian */
+            while (stream->trailerBytes < 4)
+            {
+                if (!streamHaveBits(bitBuf, 8))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+                readBitsWide(bitBuf, 8, &value);
+                stream->storedChecksum = (stream->storedChecksum << 8) | value;
+                stream->trailerBytes++;
+            }
+
+            if (!findZlibDictionary(stream->storedChecksum, &dictionary, &dictionaryLength))
+            {
+                sprintf(logMessage, "No preset dictionary registered for DICTID 0x%08lx", stream->storedChecksum);
+                return failInflateStream(stream, INFLATE_ERROR_NO_DICTIONARY, logMessage);
+            }
+
+            setInflateStreamDictionary(stream, dictionary, dictionaryLength);
+            stream->trailerBytes = 0;
+            stream->mode = INFLATE_MODE_BLOCK_HEADER;
+            break;
+        }
+
+        case INFLATE_MODE_GZIP_HEADER:
+            /* ID1 ID2 CM FLG, then MTIME, XFL and OS which are not needed */
+            while (stream->trailerBytes < 10)
+            {
+                if (!streamHaveBits(bitBuf, 8))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, 8, &value);
+                if ((stream->trailerBytes == 0 && value != 0x1F) ||
+                    (stream->trailerBytes == 1 && value != 0x8B) ||
+                    (stream->trailerBytes == 2 && value != 8) ||
+                    (stream->trailerBytes == 3 && (value & GZIP_FLAG_RESERVED)))
+                    return failInflateStream(stream, INFLATE_ERROR_BAD_HEADER, "Invalid gzip header in stream");
+
+                if (stream->trailerBytes == 3)
+                    stream->gzipFlags = (UBYTE)value;
+                stream->trailerBytes++;
+            }
+
+            LOG_TRACEF(logMessage, "gzip header: FLG=0x%02x", (int)stream->gzipFlags);
+            stream->trailerBytes = 0;
+            stream->length = 0;
+            stream->mode = INFLATE_MODE_GZIP_EXTRA;
+            break;
+
+        case INFLATE_MODE_GZIP_EXTRA:
+            /* XLEN, little-endian, then XLEN bytes of extra field to skip */
+            if (stream->gzipFlags & GZIP_FLAG_EXTRA)
+            {
+                while (stream->trailerBytes < 2)
+                {
+                    if (!streamHaveBits(bitBuf, 8))
+                        return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                    readBitsWide(bitBuf, 8, &value);
+                    stream->length |= value << (8 * stream->trailerBytes);
+                    stream->trailerBytes++;
+                }
+
+                while (stream->length > 0)
+                {
+                    if (!streamHaveBits(bitBuf, 8))
+                        return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                    consumeBits(bitBuf, 8);
+                    stream->length--;
+                }
+            }
+
+            stream->trailerBytes = 0;
+            stream->mode = INFLATE_MODE_GZIP_STRINGS;
+            break;
+
+        case INFLATE_MODE_GZIP_STRINGS:
+            /* Original file name, then comment; each flag is cleared once
+             * its terminating zero has been read */
+            while (stream->gzipFlags & (GZIP_FLAG_NAME | GZIP_FLAG_COMMENT))
+            {
+                if (!streamHaveBits(bitBuf, 8))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, 8, &value);
+                if (value == 0)
+                    stream->gzipFlags &= (stream->gzipFlags & GZIP_FLAG_NAME) ? ~GZIP_FLAG_NAME : ~GZIP_FLAG_COMMENT;
+            }
+
+            stream->mode = INFLATE_MODE_GZIP_HEADER_CRC;
+            break;
+
+        case INFLATE_MODE_GZIP_HEADER_CRC:
+            /* Header CRC-16 is skipped; the trailer CRC-32 covers the data */
+            if (stream->gzipFlags & GZIP_FLAG_HCRC)
+            {
+                if (!streamHaveBits(bitBuf, 16))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                consumeBits(bitBuf, 16);
+            }
+
+            stream->mode = INFLATE_MODE_BLOCK_HEADER;
+            break;
+
+        case INFLATE_MODE_BLOCK_HEADER:
+            if (stream->lastBlock)
+            {
+                if (stream->format == INFLATE_FORMAT_ZLIB || stream->format == INFLATE_FORMAT_GZIP)
+                {
+                    consumeBits(bitBuf, bitBuf->bitsAvail & 7);
+                    stream->storedChecksum = 0;
+                    stream->trailerBytes = 0;
+                    stream->length = 0;
+                    stream->mode = (stream->format == INFLATE_FORMAT_ZLIB) ? INFLATE_MODE_CHECK : INFLATE_MODE_GZIP_TRAILER;
+                }
+                else
+                {
+                    stream->mode = INFLATE_MODE_DONE;
+                }
+                break;
+            }
+
+            if (!streamHaveBits(bitBuf, 3))
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+            readBitsWide(bitBuf, 3, &value);
+            stream->lastBlock = (value & 1) != 0;
+
+            switch (value >> 1)
+            {
+            case 0: /* Uncompressed block, starts on the next byte boundary */
+                consumeBits(bitBuf, bitBuf->bitsAvail & 7);
+                stream->mode = INFLATE_MODE_STORED_LENGTH;
+                break;
+
+            case 1: /* Fixed Huffman codes */
+                if (!getFixedHuffmanTables(&stream->currentLiterals, &stream->currentDistances))
+                    return failInflateStream(stream, INFLATE_ERROR_NO_MEMORY, "Failed to get fixed Huffman tables");
+                stream->mode = INFLATE_MODE_LENGTH;
+                break;
+
+            case 2: /* Dynamic Huffman codes */
+                stream->mode = INFLATE_MODE_TABLE_COUNTS;
+                break;
+
+            default:
+                return failInflateStream(stream, INFLATE_ERROR_BAD_BLOCK_TYPE, "Invalid block type in stream");
+            }
+            break;
+
+        case INFLATE_MODE_STORED_LENGTH:
+            if (!streamHaveBits(bitBuf, 16))
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+            readBitsWide(bitBuf, 16, &stream->length);
+            stream->mode = INFLATE_MODE_STORED_CHECK;
+            break;
+
+        case INFLATE_MODE_STORED_CHECK:
+            if (!streamHaveBits(bitBuf, 16))
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+            readBitsWide(bitBuf, 16, &value);
+            if ((stream->length ^ 0xFFFF) != value)
+            {
+                sprintf(logMessage, "Invalid length in uncompressed block: len=%lu, nlen=%lu", stream->length, value);
+                return failInflateStream(stream, INFLATE_ERROR_BAD_STORED_LENGTH, logMessage);
+            }
+            stream->mode = INFLATE_MODE_STORED_COPY;
+            break;
+
+        case INFLATE_MODE_STORED_COPY:
+            while (stream->length > 0)
+            {
+                ULONG count;
+
+                if (stream->availOut == 0)
+                    return leaveInflateStream(stream, INFLATE_STREAM_OUTPUT_FULL);
+
+                /* Whole bytes already in the accumulator come first */
+                if (bitBuf->bitsAvail >= 8)
+                {
+                    readBitsWide(bitBuf, 8, &value);
+                    *stream->nextOut++ = (UBYTE)value;
+                    stream->availOut--;
+                    stream->length--;
+                    continue;
+                }
+
+                count = bitBuf->size - bitBuf->pos;
+                if (count == 0)
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+                if (count > stream->length)
+                    count = stream->length;
+                if (count > stream->availOut)
+                    count = stream->availOut;
+
+                memcpy(stream->nextOut, bitBuf->data + bitBuf->pos, count);
+                bitBuf->pos += count;
+                bitBuf->bitCount += count * 8;
+                stream->nextOut += count;
+                stream->availOut -= count;
+                stream->length -= count;
+            }
+            stream->mode = INFLATE_MODE_BLOCK_HEADER;
+            break;
+
+        case INFLATE_MODE_TABLE_COUNTS:
+            if (!streamHaveBits(bitBuf, 14))
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+            readBitsWide(bitBuf, 14, &value);
+            stream->hlit = (value & 0x1F) + 257;
+            stream->hdist = ((value >> 5) & 0x1F) + 1;
+            stream->hclen = ((value >> 10) & 0x0F) + 4;
+
+            if (stream->hlit > MAX_LITERAL_CODES || stream->hdist > MAX_DISTANCE_CODES)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_CODE_COUNTS, "Invalid dynamic Huffman code counts");
+
+            memset(stream->codeLengths, 0, MAX_CODE_LENGTHS);
+            stream->lengthIndex = 0;
+            stream->mode = INFLATE_MODE_CODELEN_LENS;
+            break;
+
+        case INFLATE_MODE_CODELEN_LENS:
+            while (stream->lengthIndex < stream->hclen)
+            {
+                if (!streamHaveBits(bitBuf, 3))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, 3, &value);
+                stream->codeLengths[codelenCodeOrder[stream->lengthIndex++]] = (UBYTE)value;
+            }
+
+            if (!buildHuffmanTableInto(stream->codeLengths, MAX_CODE_LENGTHS, &stream->codeLengthTable,
+                                       stream->workspace->codeLengthEntries, INFLATE_CODELEN_TABLE_ENTRIES))
+                return failInflateStream(stream, getTableBuildError(&stream->codeLengthTable),
+                                         "Failed to build Huffman tree for code lengths");
+
+            stream->lengthIndex = 0;
+            stream->lengthSymbol = NO_LENGTH_SYMBOL;
+            stream->mode = INFLATE_MODE_CODE_LENGTHS;
+            break;
+
+        case INFLATE_MODE_CODE_LENGTHS:
+            while (stream->lengthIndex < stream->hlit + stream->hdist)
+            {
+                UBYTE repeatLength = 0;
+                UBYTE repeatBits;
+                ULONG repeatCount;
+
+                if (stream->lengthSymbol == NO_LENGTH_SYMBOL)
+                {
+                    status = streamDecodeSymbol(bitBuf, &stream->codeLengthTable, &symbol);
+                    if (status == STREAM_SYMBOL_NEED_INPUT)
+                        return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+                    if (status == STREAM_SYMBOL_INVALID)
+                        return failInflateStream(stream, INFLATE_ERROR_BAD_SYMBOL, "Error decoding literal/length or distance code length");
+
+                    if (symbol < 16)
+                    {
+                        /* Direct code length 0-15 */
+                        stream->codeLengths[stream->lengthIndex++] = (UBYTE)symbol;
+                        continue;
+                    }
+
+                    stream->lengthSymbol = symbol;
+                }
+
+                /* Repeat codes: 16 repeats the previous length 3-6 times,
+                 * 17 and 18 repeat zero 3-10 and 11-138 times */
+                repeatBits = (stream->lengthSymbol == 16) ? 2 : (stream->lengthSymbol == 17) ? 3 : 7;
+                if (!streamHaveBits(bitBuf, repeatBits))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, repeatBits, &repeatCount);
+                repeatCount += (stream->lengthSymbol == 18) ? 11 : 3;
+
+                if (stream->lengthSymbol == 16)
+                {
+                    if (stream->lengthIndex == 0)
+                        return failInflateStream(stream, INFLATE_ERROR_BAD_CODE_LENGTHS, "Repeat code with no previous code length");
+                    repeatLength = stream->codeLengths[stream->lengthIndex - 1];
+                }
+
+                if (stream->lengthIndex + repeatCount > (ULONG)(stream->hlit + stream->hdist))
+                    return failInflateStream(stream, INFLATE_ERROR_BAD_CODE_LENGTHS, "Code length repeat runs past the end of the code lengths");
+
+                while (repeatCount--)
+                    stream->codeLengths[stream->lengthIndex++] = repeatLength;
+
+                stream->lengthSymbol = NO_LENGTH_SYMBOL;
+            }
+
+            /* A block without an end-of-block code could never finish */
+            if (stream->codeLengths[END_OF_BLOCK] == 0)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_CODE_LENGTHS, "Dynamic block has no end-of-block code");
+
+            if (!buildHuffmanTableInto(stream->codeLengths, stream->hlit, &stream->literalTable,
+                                       stream->workspace->literalEntries, INFLATE_LITERAL_TABLE_ENTRIES))
+                return failInflateStream(stream, getTableBuildError(&stream->literalTable),
+                                         "Failed to build Huffman tree for literals/lengths");
+
+            if (!buildHuffmanTableInto(stream->codeLengths + stream->hlit, stream->hdist, &stream->distanceTable,
+                                       stream->workspace->distanceEntries, INFLATE_DISTANCE_TABLE_ENTRIES))
+                return failInflateStream(stream, getTableBuildError(&stream->distanceTable),
+                                         "Failed to build Huffman tree for distances");
+
+            stream->currentLiterals = &stream->literalTable;
+            stream->currentDistances = &stream->distanceTable;
+            stream->mode = INFLATE_MODE_LENGTH;
+            break;
+
+        case INFLATE_MODE_LENGTH:
+            /* Fast loop while both slices have room to spare, careful
+             * decoding one symbol at a time near their ends */
+            if (stream->availOut >= INFLATE_FAST_MIN_OUTPUT &&
+                bitBuf->size - bitBuf->pos >= INFLATE_FAST_MIN_INPUT)
+            {
+                inflateStreamFast(stream);
+                if (stream->mode != INFLATE_MODE_LENGTH)
+                    break;
+            }
+
+            status = streamDecodeSymbol(bitBuf, stream->currentLiterals, &symbol);
+            if (status == STREAM_SYMBOL_NEED_INPUT)
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+            if (status == STREAM_SYMBOL_INVALID)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_SYMBOL, "Failed to decode literal/length value");
+
+            if (symbol < 256)
+            {
+                /* Literal byte */
+                stream->literal = (UBYTE)symbol;
+                stream->mode = INFLATE_MODE_LITERAL;
+            }
+            else if (symbol == END_OF_BLOCK)
+            {
+                endStreamBlock(stream);
+                stream->mode = INFLATE_MODE_BLOCK_HEADER;
+            }
+            else if (symbol <= 285)
+            {
+                stream->length = lengthBase[symbol - 257];
+                stream->extraBits = lengthExtraBits[symbol - 257];
+                stream->mode = INFLATE_MODE_LENGTH_EXTRA;
+            }
+            else
+            {
+                sprintf(logMessage, "Invalid literal/length code: %u", symbol);
+                return failInflateStream(stream, INFLATE_ERROR_BAD_SYMBOL, logMessage);
+            }
+            break;
+
+        case INFLATE_MODE_LITERAL:
+            if (stream->availOut == 0)
+                return leaveInflateStream(stream, INFLATE_STREAM_OUTPUT_FULL);
+
+            *stream->nextOut++ = stream->literal;
+            stream->availOut--;
+            stream->mode = INFLATE_MODE_LENGTH;
+            break;
+
+        case INFLATE_MODE_LENGTH_EXTRA:
+            if (stream->extraBits > 0)
+            {
+                if (!streamHaveBits(bitBuf, stream->extraBits))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, stream->extraBits, &value);
+                stream->length += value;
+            }
+            stream->mode = INFLATE_MODE_DISTANCE;
+            break;
+
+        case INFLATE_MODE_DISTANCE:
+            status = streamDecodeSymbol(bitBuf, stream->currentDistances, &symbol);
+            if (status == STREAM_SYMBOL_NEED_INPUT)
+                return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+            if (status == STREAM_SYMBOL_INVALID)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_SYMBOL, "Failed to decode distance value");
+
+            if (symbol >= 30)
+            {
+                sprintf(logMessage, "Invalid distance code: %u", symbol);
+                return failInflateStream(stream, INFLATE_ERROR_BAD_SYMBOL, logMessage);
+            }
+
+            stream->distance = distanceBase[symbol];
+            stream->extraBits = distanceExtraBits[symbol];
+            stream->mode = INFLATE_MODE_DISTANCE_EXTRA;
+            break;
+
+        case INFLATE_MODE_DISTANCE_EXTRA:
+            if (stream->extraBits > 0)
+            {
+                if (!streamHaveBits(bitBuf, stream->extraBits))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, stream->extraBits, &value);
+                stream->distance += value;
+            }
+
+            /* Validate the backreference against all history so far */
+            if (stream->distance > stream->windowHave + (ULONG)(stream->nextOut - stream->outStart))
+                return failInflateStream(stream, INFLATE_ERROR_INVALID_DISTANCE, "Invalid backreference: distance larger than output position");
+
+            stream->mode = INFLATE_MODE_COPY;
+            break;
+
+        case INFLATE_MODE_COPY:
+            copyStreamMatch(stream);
+            if (stream->length > 0)
+                return leaveInflateStream(stream, INFLATE_STREAM_OUTPUT_FULL);
+
+            stream->mode = INFLATE_MODE_LENGTH;
+            break;
+
+        case INFLATE_MODE_CHECK:
+            /* Adler-32 of the output, stored big-endian */
+            while (stream->trailerBytes < 4)
+            {
+                if (!streamHaveBits(bitBuf, 8))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, 8, &value);
+                stream->storedChecksum = (stream->storedChecksum << 8) | value;
+                stream->trailerBytes++;
+            }
+
+            accountStreamOutput(stream);
+            if (stream->verifyChecksum && stream->storedChecksum != stream->checksum)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_CHECKSUM, "Adler-32 checksum verification failed - checksums don't match");
+
+            stream->mode = INFLATE_MODE_DONE;
+            break;
+
+        case INFLATE_MODE_GZIP_TRAILER:
+            /* CRC-32 of the output, then its length modulo 2^32, both little-endian */
+            while (stream->trailerBytes < 8)
+            {
+                if (!streamHaveBits(bitBuf, 8))
+                    return leaveInflateStream(stream, INFLATE_STREAM_NEED_INPUT);
+
+                readBitsWide(bitBuf, 8, &value);
+                if (stream->trailerBytes < 4)
+                    stream->storedChecksum |= value << (8 * stream->trailerBytes);
+                else
+                    stream->length |= value << (8 * (stream->trailerBytes - 4));
+                stream->trailerBytes++;
+            }
+
+            accountStreamOutput(stream);
+            if (stream->verifyChecksum && stream->storedChecksum != stream->checksum)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_CHECKSUM, "gzip CRC-32 verification failed - checksums don't match");
+            if (stream->length != stream->totalOut)
+                return failInflateStream(stream, INFLATE_ERROR_BAD_LENGTH, "gzip ISIZE does not match the decompressed length");
+
+            stream->mode = INFLATE_MODE_DONE;
+            break;
+
+        case INFLATE_MODE_DONE:
+            return leaveInflateStream(stream, INFLATE_STREAM_DONE);
+
+        default:
+            return leaveInflateStream(stream, INFLATE_STREAM_ERROR);
+        }
+    }
+}
+
+/* Tell the stream no more input follows
+ * A stream that still wants input at this point was cut short; the error
+ * offset is the end of the data it was given */
+ULONG finishInflateStreamInput(InflateStream *stream)
+{
+    if (stream->mode == INFLATE_MODE_DONE)
+        return INFLATE_STREAM_DONE;
+
+    if (stream->mode != INFLATE_MODE_BAD)
+    {
+        LOG_DEBUG("Compressed data ended before the end of the stream");
+        stream->error = INFLATE_ERROR_TRUNCATED;
+        stream->errorBitOffset = stream->bitBuf.bitCount + stream->bitBuf.bitsAvail;
+        stream->mode = INFLATE_MODE_BAD;
+    }
+
+    return INFLATE_STREAM_ERROR;
+}
+
+/* Why the stream failed, and where */
+UBYTE getInflateStreamError(InflateStream *stream, ULONG *bitOffset)
+{
+    if (bitOffset)
+        *bitOffset = stream->errorBitOffset;
+
+    return stream->error;
+}
+
+/* Short description of an INFLATE_ERROR_* code */
+const char *getInflateErrorName(UBYTE error)
+{
+    switch (error)
+    {
+    case INFLATE_ERROR_NONE:
+        return "no error";
+    case INFLATE_ERROR_TRUNCATED:
+        return "truncated input";
+    case INFLATE_ERROR_BAD_HEADER:
+        return "invalid stream header";
+    case INFLATE_ERROR_BAD_BLOCK_TYPE:
+        return "invalid block type";
+    case INFLATE_ERROR_BAD_STORED_LENGTH:
+        return "invalid stored block length";
+    case INFLATE_ERROR_BAD_CODE_COUNTS:
+        return "invalid code counts";
+    case INFLATE_ERROR_OVERSUBSCRIBED:
+        return "over-subscribed code set";
+    case INFLATE_ERROR_INCOMPLETE:
+        return "incomplete code set";
+    case INFLATE_ERROR_BAD_CODE_LENGTHS:
+        return "invalid code lengths";
+    case INFLATE_ERROR_BAD_SYMBOL:
+        return "invalid code";
+    case INFLATE_ERROR_INVALID_DISTANCE:
+        return "invalid distance";
+    case INFLATE_ERROR_BAD_CHECKSUM:
+        return "checksum mismatch";
+    case INFLATE_ERROR_NO_MEMORY:
+        return "out of memory";
+    case INFLATE_ERROR_NO_DICTIONARY:
+        return "unknown preset dictionary";
+    case INFLATE_ERROR_BAD_LENGTH:
+        return "length mismatch";
+    default:
+        return "unknown error";
+    }
+}
+
+/* Release the workspace held by the stream */
+void endInflateStream(InflateStream *stream)
+{
+    if (!stream)
+        return;
+
+    endStreamBlock(stream);
+
+    if (stream->workspace)
+    {
+        free(stream->workspace);
+        stream->workspace = NULL;
+        stream->window = NULL;
+    }
+}
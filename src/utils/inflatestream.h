@@ -0,0 +1,155 @@
+/*
+ * Streaming DEFLATE/zlib/gzip decompression for AmigaOS 3.1
+ * Decodes compressed data supplied in arbitrary slices into
+ * caller-provided output slices, keeping only a 32 KB window resident
+ */
+
+#ifndef INFLATESTREAM_H
+#define INFLATESTREAM_H
+
+#include <exec/types.h>
+#include "zlibutils.h"
+#include "huffmanUtils.h"
+
+/* DEFLATE history window */
+#define INFLATE_WINDOW_SIZE 32768
+#define INFLATE_WINDOW_MASK (INFLATE_WINDOW_SIZE - 1)
+
+/* Lookup table storage for dynamic blocks. The literal/length and distance
+ * sizes are the largest tables any complete code can need with the root
+ * widths in huffmanUtils.h (zlib's ENOUGH_LENS and ENOUGH_DISTS); the code
+ * length alphabet adds at most nine 1-bit sub-tables to its 6-bit root */
+#define INFLATE_LITERAL_TABLE_ENTRIES 852
+#define INFLATE_DISTANCE_TABLE_ENTRIES 592
+#define INFLATE_CODELEN_TABLE_ENTRIES 82
+
+/* Results of inflateStreamProcess */
+#define INFLATE_STREAM_NEED_INPUT 0   /* Input slice used up, supply the next one */
+#define INFLATE_STREAM_OUTPUT_FULL 1  /* Output slice filled, supply more room */
+#define INFLATE_STREAM_DONE 2         /* Final block decoded and trailer checked */
+#define INFLATE_STREAM_ERROR 3        /* Corrupt or unsupported data */
+
+/* Error codes reported by getInflateStreamError */
+#define INFLATE_ERROR_NONE 0
+#define INFLATE_ERROR_TRUNCATED 1          /* Input ended before the final block and trailer */
+#define INFLATE_ERROR_BAD_HEADER 2         /* Invalid zlib or gzip header */
+#define INFLATE_ERROR_BAD_BLOCK_TYPE 3     /* Reserved block type 3 */
+#define INFLATE_ERROR_BAD_STORED_LENGTH 4  /* Stored block LEN and NLEN disagree */
+#define INFLATE_ERROR_BAD_CODE_COUNTS 5    /* HLIT or HDIST out of range */
+#define INFLATE_ERROR_OVERSUBSCRIBED 6     /* Code lengths describe more codes than exist */
+#define INFLATE_ERROR_INCOMPLETE 7         /* Code lengths leave codes unused */
+#define INFLATE_ERROR_BAD_CODE_LENGTHS 8   /* Repeat code with nothing to repeat or past the end */
+#define INFLATE_ERROR_BAD_SYMBOL 9         /* Unused Huffman code or reserved symbol */
+#define INFLATE_ERROR_INVALID_DISTANCE 10  /* Match reaches back past the start of the output */
+#define INFLATE_ERROR_BAD_CHECKSUM 11      /* Adler-32 or CRC-32 trailer mismatch */
+#define INFLATE_ERROR_NO_MEMORY 12         /* Fixed Huffman tables could not be built */
+#define INFLATE_ERROR_NO_DICTIONARY 13     /* FDICT names a dictionary that is not registered */
+#define INFLATE_ERROR_BAD_LENGTH 14        /* gzip ISIZE trailer mismatch */
+#define INFLATE_ERROR_MAX INFLATE_ERROR_BAD_LENGTH
+
+/* Stream formats for initInflateStream */
+#define INFLATE_FORMAT_RAW 0  /* Bare DEFLATE blocks */
+#define INFLATE_FORMAT_ZLIB 1 /* RFC 1950 header and Adler-32 trailer */
+#define INFLATE_FORMAT_GZIP 2 /* RFC 1952 member header, CRC-32 and ISIZE trailer */
+
+/* Everything the decoder needs besides its bookkeeping, allocated once by
+ * initInflateStream and reused for every block and every resetInflateStream */
+typedef struct InflateWorkspace
+{
+    UBYTE window[INFLATE_WINDOW_SIZE];
+    HuffmanEntry codeLengthEntries[INFLATE_CODELEN_TABLE_ENTRIES];
+    HuffmanEntry literalEntries[INFLATE_LITERAL_TABLE_ENTRIES];
+    HuffmanEntry distanceEntries[INFLATE_DISTANCE_TABLE_ENTRIES];
+} InflateWorkspace;
+
+/* Streaming inflater state
+ * Every field is private to inflatestream.c except the input and output
+ * slice bookkeeping, which callers may read between calls */
+typedef struct InflateStream
+{
+    BitBuffer bitBuf;       /* Current input slice plus the bit accumulator */
+    UBYTE *nextOut;         /* Next free byte of the output slice */
+    ULONG availOut;         /* Free bytes left in the output slice */
+    ULONG totalOut;         /* Bytes produced since initInflateStream */
+
+    UBYTE format;           /* INFLATE_FORMAT_* */
+    UBYTE mode;             /* Position in the decoder state machine */
+    BOOL lastBlock;         /* BFINAL was set on the current block */
+
+    InflateWorkspace *workspace; /* Window and dynamic table storage */
+    UBYTE *window;          /* Last INFLATE_WINDOW_SIZE bytes of output */
+    ULONG windowPos;        /* Next write position in the window */
+    ULONG windowHave;       /* Valid history bytes in the window */
+    UBYTE *outStart;        /* Output produced this call that is not yet in the window */
+
+    ULONG length;           /* Pending match length, stored block or gzip field bytes, or gzip ISIZE */
+    ULONG distance;         /* Pending match distance */
+    UBYTE extraBits;        /* Extra bits still to read for length or distance */
+    UBYTE literal;          /* Literal waiting for output space */
+
+    UWORD hlit;             /* Dynamic block literal/length code count */
+    UWORD hdist;            /* Dynamic block distance code count */
+    UWORD hclen;            /* Dynamic block code length code count */
+    UWORD lengthIndex;      /* Next code length to read */
+    UWORD lengthSymbol;     /* Code length symbol waiting for its extra bits */
+    UBYTE codeLengths[MAX_LITERAL_CODES + MAX_DISTANCE_CODES];
+
+    HuffmanTable codeLengthTable;
+    HuffmanTable literalTable;
+    HuffmanTable distanceTable;
+    HuffmanTable *currentLiterals;  /* Fixed or dynamic literal/length table */
+    HuffmanTable *currentDistances; /* Fixed or dynamic distance table */
+
+    BOOL verifyChecksum;    /* Check the zlib Adler-32 or gzip CRC-32 trailer */
+    ULONG checksum;         /* Running Adler-32 or CRC-32 of the output */
+    ULONG storedChecksum;   /* Trailer or DICTID value being read */
+    UBYTE trailerBytes;     /* Header, trailer or DICTID bytes read so far */
+    UBYTE gzipFlags;        /* gzip FLG bits whose fields are still to be skipped */
+
+    UBYTE error;            /* INFLATE_ERROR_* once the stream has failed */
+    ULONG errorBitOffset;   /* Input bits consumed when the error was found */
+} InflateStream;
+
+/* Prepare a stream for decoding; allocates the window and table workspace */
+BOOL initInflateStream(InflateStream *stream, UBYTE format);
+
+/* Start decoding a new stream, keeping the workspace of an initialised one */
+void resetInflateStream(InflateStream *stream, UBYTE format);
+
+/* Enable or disable zlib Adler-32 / gzip CRC-32 verification (on by default)
+ * Only turn it off for trusted data such as assets bundled with the editor */
+void setInflateStreamChecksum(InflateStream *stream, BOOL verify);
+
+/* Prime the window with a preset dictionary before any data is decoded
+ * zlib streams with FDICT set do this themselves from the registry in
+ * zlibutils.h; this is for raw streams that share a dictionary */
+BOOL setInflateStreamDictionary(InflateStream *stream, const UBYTE *dictionary, ULONG length);
+
+/* Supply the next slice of compressed input */
+void setInflateStreamInput(InflateStream *stream, UBYTE *data, ULONG size);
+
+/* Supply the next slice of output space */
+void setInflateStreamOutput(InflateStream *stream, UBYTE *buffer, ULONG size);
+
+/* Unconsumed bytes left in the current input slice */
+ULONG getInflateStreamInputLeft(InflateStream *stream);
+
+/* Decode as far as the current slices allow */
+ULONG inflateStreamProcess(InflateStream *stream);
+
+/* Tell the stream no more input follows
+ * Returns INFLATE_STREAM_DONE for a finished stream; anything else is
+ * failed as INFLATE_ERROR_TRUNCATED and returns INFLATE_STREAM_ERROR */
+ULONG finishInflateStreamInput(InflateStream *stream);
+
+/* Why the stream failed (INFLATE_ERROR_*), and optionally the input bit
+ * offset at which the problem was detected */
+UBYTE getInflateStreamError(InflateStream *stream, ULONG *bitOffset);
+
+/* Short description of an INFLATE_ERROR_* code */
+const char *getInflateErrorName(UBYTE error);
+
+/* Release the workspace held by the stream */
+void endInflateStream(InflateStream *stream);
+
+#endif /* INFLATESTREAM_H */
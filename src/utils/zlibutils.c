@@ -1,6 +1,6 @@
 /*
  * Basic zlib utilities for AmigaOS 3.1
- * Used for decompressing zlib data in PNG files
+ * Used for decompressing zlib data in PNG files and compressing it for saving
  */
 
 #include <stdio.h>
@@ -11,139 +11,92 @@
 #include <proto/dos.h>
 #include "zlibutils.h"
 #include "huffmanUtils.h"
+#include "inflatestream.h"
+#include "deflateutils.h"
 #include "filelogger.h"
 
-/* Process an unsupported block type (fixed or dynamic Huffman) by skipping it */
-BOOL processSkipUnsupportedBlock(BitBuffer *bitBuf, BOOL isFinalBlock, const char *blockTypeName)
+/* Log why a stream failed and how far into the compressed data */
+static void logInflateStreamError(InflateStream *stream)
 {
     char logMessage[256];
+    ULONG bitOffset;
+    UBYTE error;
 
-    sprintf(logMessage, "%s Huffman codes not implemented in this version", blockTypeName);
-    fileLoggerAddDebugEntry(logMessage);
+    error = getInflateStreamError(stream, &bitOffset);
+    LOG_ERRORF(logMessage, "DEFLATE decompression failed: %s at bit %lu (byte %lu)",
+               getInflateErrorName(error), bitOffset, bitOffset / 8);
+}
 
-    /* Skip this block and move to the next one */
-    if (isFinalBlock)
-    {
-        /* If this is the final block, we should stop */
-        fileLoggerAddDebugEntry("Final block has unsupported compression type");
-        return FALSE;
-    }
+/* Initialize a bit buffer for reading compressed data */
+void initBitBuffer(BitBuffer *buffer, UBYTE *data, ULONG size, ULONG startPos)
+{
+    buffer->data = data;
+    buffer->size = size;
+    buffer->pos = startPos;
+    buffer->bitAccum = 0;
+    buffer->bitsAvail = 0;
+    buffer->bitCount = 0;
+}
 
-    /* Skip a few bytes to hopefully find the next block */
-    bitBuf->pos++;
-    if (bitBuf->bitPos > 0)
+/* Top up the accumulator from the byte stream
+ * Loads whole bytes until more than BITBUFFER_MAX_BITS bits are buffered
+ * or the input runs out */
+void refillBitBuffer(BitBuffer *buffer)
+{
+    while (buffer->bitsAvail <= BITBUFFER_MAX_BITS && buffer->pos < buffer->size)
     {
-        bitBuf->bitPos = 0;
-        bitBuf->pos++;
+        buffer->bitAccum |= (ULONG)buffer->data[buffer->pos++] << buffer->bitsAvail;
+        buffer->bitsAvail += 8;
     }
-
-    return TRUE;
 }
 
-/* Process an uncompressed (type 0) DEFLATE block */
-BOOL processUncompressedBlock(BitBuffer *bitBuf, UBYTE *compressedData, ULONG compressedSize,
-                              UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos)
+/* Return the next numBits bits without consuming them */
+ULONG peekBits(BitBuffer *buffer, UBYTE numBits)
 {
-    ULONG len, nlen;
-    char logMessage[256];
+    if (buffer->bitsAvail < numBits)
+        refillBitBuffer(buffer);
 
-    /* Skip to byte boundary */
-    if (bitBuf->bitPos > 0)
-    {
-        bitBuf->bitPos = 0;
-        bitBuf->pos++;
-    }
+    return buffer->bitAccum & ((1UL << numBits) - 1);
+}
 
-    /* Make sure we have enough data for the block header */
-    if (bitBuf->pos + 4 > compressedSize)
-    {
-        fileLoggerAddDebugEntry("Not enough data for uncompressed block header");
+/* Consume numBits bits previously inspected with peekBits */
+BOOL consumeBits(BitBuffer *buffer, UBYTE numBits)
+{
+    /* Not enough input left for the bits the caller decoded */
+    if (numBits > buffer->bitsAvail)
         return FALSE;
-    }
-
-    /* Read length and complement (little-endian) */
-    len = compressedData[bitBuf->pos] | (compressedData[bitBuf->pos + 1] << 8);
-    nlen = compressedData[bitBuf->pos + 2] | (compressedData[bitBuf->pos + 3] << 8);
-    bitBuf->pos += 4;
 
-    /* Verify length with complement */
-    if ((len ^ 0xFFFF) != nlen)
-    {
-        sprintf(logMessage, "Invalid length in uncompressed block: len=%lu, nlen=%lu", len, nlen);
-        fileLoggerAddDebugEntry(logMessage);
-        return FALSE;
-    }
+    buffer->bitAccum >>= numBits;
+    buffer->bitsAvail -= numBits;
+    buffer->bitCount += numBits;
 
-    sprintf(logMessage, "Uncompressed block: length=%lu", len);
-    fileLoggerAddDebugEntry(logMessage);
+    return TRUE;
+}
 
-    /* Copy uncompressed data */
-    if (bitBuf->pos + len > compressedSize)
-    {
-        fileLoggerAddDebugEntry("Not enough input data for uncompressed block");
-        return FALSE;
-    }
+/* Read up to BITBUFFER_MAX_BITS bits from the bit buffer (LSB first) */
+BOOL readBitsWide(BitBuffer *buffer, UBYTE numBits, ULONG *value)
+{
+    ULONG result;
 
-    if (*outPos + len > outputBufferSize)
-    {
-        fileLoggerAddDebugEntry("Output buffer too small for uncompressed data");
+    if (!value || numBits > BITBUFFER_MAX_BITS)
         return FALSE;
-    }
 
-    /* Copy the data */
-    memcpy(outputBuffer + *outPos, compressedData + bitBuf->pos, len);
-    bitBuf->pos += len;
-    *outPos += len;
+    result = peekBits(buffer, numBits);
+    if (!consumeBits(buffer, numBits))
+        return FALSE; /* Not enough bits available */
 
+    *value = result;
     return TRUE;
 }
 
-/* Initialize a bit buffer for reading compressed data */
-void initBitBuffer(BitBuffer *buffer, UBYTE *data, ULONG size, ULONG startPos)
-{
-    buffer->data = data;
-    buffer->size = size;
-    buffer->pos = startPos;
-    buffer->bitPos = 0;
-    buffer->bitCount = 0;
-}
-
-/* Read bits from the bit buffer (LSB first) */
+/* Read up to 8 bits from the bit buffer (LSB first) */
 BOOL readBits(BitBuffer *buffer, UBYTE numBits, UBYTE *value)
 {
-    ULONG result = 0;
-    UBYTE bitsRead = 0;
+    ULONG result;
 
-    /* Make sure we don't read past the end of the buffer */
-    if (buffer->pos >= buffer->size || !value)
+    if (!value || numBits > 8 || !readBitsWide(buffer, numBits, &result))
         return FALSE;
 
-    /* Read bits one at a time */
-    while (bitsRead < numBits)
-    {
-        /* Read the current bit */
-        UBYTE bit = (buffer->data[buffer->pos] >> buffer->bitPos) & 1;
-
-        /* Add the bit to our result */
-        result |= (bit << bitsRead);
-
-        /* Move to the next bit */
-        buffer->bitPos++;
-        buffer->bitCount++;
-        bitsRead++;
-
-        /* If we've read all bits in the current byte, move to the next byte */
-        if (buffer->bitPos == 8)
-        {
-            buffer->bitPos = 0;
-            buffer->pos++;
-
-            /* Check if we've reached the end of the buffer */
-            if (buffer->pos >= buffer->size && bitsRead < numBits)
-                return FALSE; /* Not enough bits available */
-        }
-    }
-
     *value = (UBYTE)result;
     return TRUE;
 }
@@ -169,7 +122,7 @@ BOOL processZlibHeader(UBYTE *compressedData, ULONG compressedSize, UBYTE *compr
     if (!compressedData || compressedSize < 2 || !compressionMethod || !compressionInfo ||
         !fCheck || !hasDictionary || !compressionLevel)
     {
-        fileLoggerAddDebugEntry("Invalid parameters for processZlibHeader");
+        LOG_DEBUG("Invalid parameters for processZlibHeader");
         return FALSE;
     }
 
@@ -188,17 +141,15 @@ BOOL processZlibHeader(UBYTE *compressedData, ULONG compressedSize, UBYTE *compr
     /* Check if the compression method is 8 (DEFLATE) */
     if (*compressionMethod != 8)
     {
-        sprintf(logMessage, "Unsupported compression method: %i (expected 8 for DEFLATE)",
-                (int)*compressionMethod);
-        fileLoggerAddDebugEntry(logMessage);
+        LOG_DEBUGF(logMessage, "Unsupported compression method: %i (expected 8 for DEFLATE)",
+                   (int)*compressionMethod);
         return FALSE;
     }
 
     /* Validate window size - CINFO must be between 0-7 for DEFLATE */
     if (*compressionInfo > 7)
     {
-        sprintf(logMessage, "Invalid compression info (window size): %d", (int)*compressionInfo);
-        fileLoggerAddDebugEntry(logMessage);
+        LOG_DEBUGF(logMessage, "Invalid compression info (window size): %d", (int)*compressionInfo);
         return FALSE;
     }
 
@@ -206,263 +157,495 @@ BOOL processZlibHeader(UBYTE *compressedData, ULONG compressedSize, UBYTE *compr
     ULONG checksum = cmf * 256 + flg;
     if (checksum % 31 != 0)
     {
-        sprintf(logMessage, "Invalid zlib header checksum: %lu is not divisible by 31",
-                checksum);
-        fileLoggerAddDebugEntry(logMessage);
-        sprintf(logMessage, "Invalid zlib header checksum: %lu is not divisible by 31", (unsigned long)checksum);
+        LOG_DEBUGF(logMessage, "Invalid zlib header checksum: %lu is not divisible by 31",
+                   checksum);
         return FALSE;
     }
 
     /* Log header information */
-    sprintf(logMessage, "Zlib header: CM=%d, CINFO=%d, FCHECK=%d, FDICT=%d, FLEVEL=%d",
-            (int)*compressionMethod, (int)*compressionInfo, (int)*fCheck, (int)*hasDictionary, (int)*compressionLevel);
-    fileLoggerAddDebugEntry(logMessage);
+    LOG_DEBUGF(logMessage, "Zlib header: CM=%d, CINFO=%d, FCHECK=%d, FDICT=%d, FLEVEL=%d",
+               (int)*compressionMethod, (int)*compressionInfo, (int)*fCheck, (int)*hasDictionary, (int)*compressionLevel);
 
-    /* If a preset dictionary is present, we need to handle that */
+    /* The 4-byte DICTID that follows is resolved through the dictionary registry */
     if (*hasDictionary)
+        LOG_DEBUG("Stream uses a preset dictionary");
+
+    return TRUE;
+}
+
+/* Preset dictionaries known to the inflater, looked up by DICTID
+ * Only pointers are kept; the caller owns the dictionary data */
+typedef struct ZlibDictionary
+{
+    ULONG id;          /* Adler-32 of the dictionary */
+    const UBYTE *data;
+    ULONG length;
+} ZlibDictionary;
+
+static ZlibDictionary zlibDictionaries[ZLIB_MAX_DICTIONARIES];
+static ULONG zlibDictionaryCount = 0;
+
+/* Register a preset dictionary for zlib streams with FDICT set
+ * The data must stay valid until the dictionary is unregistered.
+ * Registering the same dictionary again just returns its ID */
+BOOL registerZlibDictionary(const UBYTE *dictionary, ULONG length, ULONG *dictId)
+{
+    char logMessage[256];
+    ULONG id;
+    ULONG i;
+
+    if (!dictionary || length == 0)
+    {
+        LOG_DEBUG("Invalid parameters for registerZlibDictionary");
+        return FALSE;
+    }
+
+    id = adler32Update(1, (UBYTE *)dictionary, length);
+    if (dictId)
+        *dictId = id;
+
+    for (i = 0; i < zlibDictionaryCount; i++)
     {
-        fileLoggerAddDebugEntry("Warning: Preset dictionary is not supported in this implementation");
-        /* In a complete implementation, we would check for a 4-byte ADLER32 checksum
-           of the dictionary that follows the header */
+        if (zlibDictionaries[i].id == id)
+        {
+            zlibDictionaries[i].data = dictionary;
+            zlibDictionaries[i].length = length;
+            return TRUE;
+        }
     }
 
+    if (zlibDictionaryCount == ZLIB_MAX_DICTIONARIES)
+    {
+        LOG_ERROR("Too many zlib preset dictionaries registered");
+        return FALSE;
+    }
+
+    zlibDictionaries[zlibDictionaryCount].id = id;
+    zlibDictionaries[zlibDictionaryCount].data = dictionary;
+    zlibDictionaries[zlibDictionaryCount].length = length;
+    zlibDictionaryCount++;
+
+    LOG_DEBUGF(logMessage, "Registered zlib dictionary 0x%08lx (%lu bytes)", id, length);
     return TRUE;
 }
 
-/* SIMPLIFIED IMPLEMENTATION - In a real system we would:
- * 1. Process zlib header (CMF, FLG) - DONE
- * 2. Process deflate blocks (using Huffman decoding)
- * 3. Verify the Adler-32 checksum at the end
- *
- * For this proof of concept, we'll just do minimal processing
- * and return an empty buffer with a success status */
-
-/* Constants for DEFLATE decompression */
-#define BLOCK_TYPE_NONE 0    /* No compression */
-#define BLOCK_TYPE_FIXED 1   /* Fixed Huffman codes */
-#define BLOCK_TYPE_DYNAMIC 2 /* Dynamic Huffman codes */
-#define BLOCK_TYPE_ERROR 3   /* Reserved (error) */
-
-/* Basic implementation of DEFLATE decompression algorithm
- * This is a simplified version that handles the most common case:
- * uncompressed blocks (type 0) and non-compressed data
- */
-BOOL inflateData(UBYTE *compressedData, ULONG compressedSize, ULONG startPos, UBYTE *outputBuffer,
-                 ULONG outputBufferSize, ULONG *bytesWritten)
+/* Forget a registered preset dictionary */
+void unregisterZlibDictionary(ULONG dictId)
+{
+    ULONG i;
+
+    for (i = 0; i < zlibDictionaryCount; i++)
+    {
+        if (zlibDictionaries[i].id == dictId)
+        {
+            zlibDictionaries[i] = zlibDictionaries[--zlibDictionaryCount];
+            return;
+        }
+    }
+}
+
+/* Find a registered preset dictionary by its Adler-32 ID */
+BOOL findZlibDictionary(ULONG dictId, const UBYTE **dictionary, ULONG *length)
+{
+    ULONG i;
+
+    for (i = 0; i < zlibDictionaryCount; i++)
+    {
+        if (zlibDictionaries[i].id == dictId)
+        {
+            *dictionary = zlibDictionaries[i].data;
+            *length = zlibDictionaries[i].length;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Decompress a whole zlib stream into a newly allocated buffer
+ * The buffer grows as the stream decodes, since the output size is not
+ * stored in the stream */
+BOOL decompressZlibData(UBYTE *compressedData, ULONG compressedSize, UBYTE **decompressedData, ULONG *decompressedSize)
 {
     char logMessage[256];
-    ULONG outPos = 0; /* Current position in output */
-    BOOL isFinalBlock = FALSE;
-    UBYTE blockType, bitValue;
-    ULONG len, nlen;
-    BitBuffer bitBuf;
+    InflateStream stream;
+    UBYTE *outputBuffer;
+    UBYTE *grownBuffer;
+    ULONG outputSize;
+    ULONG result;
 
-    /* Initialize bit buffer */
-    initBitBuffer(&bitBuf, compressedData, compressedSize, startPos);
+    /* Validate parameters */
+    if (!compressedData || compressedSize == 0 || !decompressedData || !decompressedSize)
+    {
+        LOG_DEBUG("Invalid parameters for zlib decompression");
+        return FALSE;
+    }
 
-    *bytesWritten = 0;
+    *decompressedData = NULL;
+    *decompressedSize = 0;
 
-    fileLoggerAddDebugEntry("Starting DEFLATE decompression");
+    /* The output size is unknown, so start from a modest guess and
+     * double the buffer whenever the stream fills it */
+    outputSize = compressedSize * ZLIB_GROW_INITIAL_RATIO;
+    if (outputSize < ZLIB_GROW_MIN_SIZE)
+        outputSize = ZLIB_GROW_MIN_SIZE;
 
-    /* Process blocks until we find the final block */
-    while (!isFinalBlock && bitBuf.pos < compressedSize && outPos < outputBufferSize)
+    outputBuffer = (UBYTE *)malloc(outputSize);
+    if (!outputBuffer)
     {
-        /* Read block header (3 bits) */
-        if (!readBits(&bitBuf, 1, &bitValue))
-            return FALSE;
-        isFinalBlock = bitValue != 0;
+        LOG_DEBUG("Failed to allocate memory for decompressed data");
+        return FALSE;
+    }
 
-        if (!readBits(&bitBuf, 2, &blockType))
-            return FALSE;
+    if (!initInflateStream(&stream, INFLATE_FORMAT_ZLIB))
+    {
+        free(outputBuffer);
+        return FALSE;
+    }
 
-        sprintf(logMessage, "Block header: Final=%d, Type=%d", (int)isFinalBlock, (int)blockType);
-        fileLoggerAddDebugEntry(logMessage);
+    setInflateStreamInput(&stream, compressedData, compressedSize);
+    setInflateStreamOutput(&stream, outputBuffer, outputSize);
 
-        /* Process based on block type */
-        switch (blockType)
+    while ((result = inflateStreamProcess(&stream)) == INFLATE_STREAM_OUTPUT_FULL)
+    {
+        grownBuffer = (UBYTE *)realloc(outputBuffer, outputSize * 2);
+        if (!grownBuffer)
         {
-        case BLOCK_TYPE_NONE: /* Uncompressed block */
-            if (!processUncompressedBlock(&bitBuf, compressedData, compressedSize, outputBuffer, outputBufferSize, &outPos))
-            {
-                return FALSE;
-            }
+            LOG_DEBUG("Failed to grow decompressed data buffer");
             break;
+        }
 
-        case BLOCK_TYPE_FIXED: /* Fixed Huffman codes */
-            if (!processFixedHuffmanBlock(&bitBuf, compressedData, compressedSize, outputBuffer, outputBufferSize, &outPos))
-            {
-                return FALSE;
-            }
-            break;
+        outputBuffer = grownBuffer;
+        setInflateStreamOutput(&stream, outputBuffer + outputSize, outputSize);
+        outputSize *= 2;
+    }
 
-        case BLOCK_TYPE_DYNAMIC: /* Dynamic Huffman codes */
-            if (!processDynamicHuffmanBlock(&bitBuf, compressedData, compressedSize, outputBuffer, outputBufferSize, &outPos))
-            {
-                return FALSE;
-            }
-            break;
+    if (result == INFLATE_STREAM_NEED_INPUT)
+        result = finishInflateStreamInput(&stream);
 
-        default: /* Error or unknown block type */
-            fileLoggerAddDebugEntry("Invalid block type");
-            return FALSE;
-        }
+    endInflateStream(&stream);
+
+    if (result != INFLATE_STREAM_DONE)
+    {
+        if (result == INFLATE_STREAM_ERROR)
+            logInflateStreamError(&stream);
+        free(outputBuffer);
+        return FALSE;
     }
 
-    *bytesWritten = outPos;
+    /* Give back the unused tail of the buffer */
+    *decompressedSize = stream.totalOut;
+    if (stream.totalOut > 0 && stream.totalOut < outputSize)
+    {
+        grownBuffer = (UBYTE *)realloc(outputBuffer, stream.totalOut);
+        if (grownBuffer)
+            outputBuffer = grownBuffer;
+    }
+    *decompressedData = outputBuffer;
 
-    sprintf(logMessage, "DEFLATE decompression completed: %lu bytes decompressed", outPos);
-    fileLoggerAddDebugEntry(logMessage);
+    LOG_DEBUGF(logMessage, "Successful decompression: %lu bytes compressed, %lu bytes decompressed",
+               compressedSize, *decompressedSize);
 
     return TRUE;
 }
 
-/* Basic zlib data decompression function
- * This is a very simplified implementation that handles the bare minimum
- * needed to decompress zlib-compressed data in PNG files
- */
-BOOL decompressZlibData(UBYTE *compressedData, ULONG compressedSize, UBYTE **decompressedData, ULONG *decompressedSize)
+/* Decompress zlib data whose inflated size is known in advance
+ * The output goes straight into the caller's buffer with no extra
+ * allocation; data that would overflow outputSize is an error */
+BOOL decompressZlibDataToBuffer(UBYTE *compressedData, ULONG compressedSize, UBYTE *outputBuffer, ULONG outputSize,
+                                ULONG *decompressedSize)
 {
-    char logMessage[256];
-    UBYTE compressionMethod = 0;
-    UBYTE compressionInfo = 0;
-    UBYTE fCheck = 0;
-    BOOL hasDictionary = FALSE;
-    UBYTE compressionLevel = 0;
+    InflateStream stream;
+    ULONG result;
 
     /* Validate parameters */
-    if (!compressedData || compressedSize == 0 || !decompressedData || !decompressedSize)
+    if (!compressedData || compressedSize == 0 || !outputBuffer || !decompressedSize)
     {
-        fileLoggerAddDebugEntry("Invalid parameters for zlib decompression");
+        LOG_DEBUG("Invalid parameters for zlib decompression");
         return FALSE;
     }
 
-    /* Process the zlib header (first 2 bytes) */
-    if (!processZlibHeader(compressedData, compressedSize, &compressionMethod, &compressionInfo,
-                           &fCheck, &hasDictionary, &compressionLevel))
+    *decompressedSize = 0;
+
+    if (!initInflateStream(&stream, INFLATE_FORMAT_ZLIB))
+        return FALSE;
+
+    setInflateStreamInput(&stream, compressedData, compressedSize);
+    setInflateStreamOutput(&stream, outputBuffer, outputSize);
+    result = inflateStreamProcess(&stream);
+    if (result == INFLATE_STREAM_NEED_INPUT)
+        result = finishInflateStreamInput(&stream);
+    endInflateStream(&stream);
+
+    switch (result)
     {
-        fileLoggerAddDebugEntry("Failed to process zlib header");
+    case INFLATE_STREAM_DONE:
+        *decompressedSize = stream.totalOut;
+        return TRUE;
+
+    case INFLATE_STREAM_OUTPUT_FULL:
+        LOG_ERROR("Output buffer overflow: decompressed data larger than expected");
+        break;
+
+    default:
+        logInflateStreamError(&stream);
+        break;
+    }
+
+    return FALSE;
+}
+
+/* Decompress a zlib or gzip file through a fixed-size input buffer
+ * Output goes into outputBuffer, or through callback in pieces of
+ * ZLIB_FILE_CHUNK_SIZE bytes when a callback is given */
+static BOOL inflateZlibFile(CONST_STRPTR filename, UBYTE *outputBuffer, ULONG outputSize,
+                            ZlibOutputCallback callback, APTR userData, ULONG *decompressedSize)
+{
+    char logMessage[256];
+    InflateStream stream;
+    FILE *file;
+    UBYTE *inputBuffer;
+    UBYTE *chunkBuffer = NULL;
+    ULONG bytesRead;
+    ULONG pending;
+    ULONG result;
+    UBYTE format;
+    BOOL success = FALSE;
+
+    *decompressedSize = 0;
+
+    file = fopen(filename, "rb");
+    if (!file)
+    {
+        LOG_ERRORF(logMessage, "Failed to open compressed file: %s", filename);
         return FALSE;
     }
 
-    /* For now, allocate a buffer for decompressed data
-     * In a real implementation, we would dynamically resize this
-     * as needed during decompression */
-    ULONG estimatedSize = compressedSize * 10; /* Increase buffer size for larger expansion ratios */
-    *decompressedData = (UBYTE *)malloc(estimatedSize);
-    if (!*decompressedData)
+    inputBuffer = (UBYTE *)malloc(ZLIB_FILE_INPUT_SIZE);
+    if (callback)
+    {
+        chunkBuffer = (UBYTE *)malloc(ZLIB_FILE_CHUNK_SIZE);
+        outputBuffer = chunkBuffer;
+        outputSize = ZLIB_FILE_CHUNK_SIZE;
+    }
+
+    if (!inputBuffer || (callback && !chunkBuffer))
     {
-        fileLoggerAddDebugEntry("Failed to allocate memory for decompressed data");
+        LOG_DEBUG("Failed to allocate file decompression buffers");
+        if (inputBuffer)
+            free(inputBuffer);
+        if (chunkBuffer)
+            free(chunkBuffer);
+        fclose(file);
         return FALSE;
     }
 
-    fileLoggerAddDebugEntry("Starting simple zlib decompression");
+    /* gzip members start with 1F 8B; anything else is taken to be zlib */
+    bytesRead = fread(inputBuffer, 1, ZLIB_FILE_INPUT_SIZE, file);
+    format = (bytesRead >= 2 && inputBuffer[0] == 0x1F && inputBuffer[1] == 0x8B) ? INFLATE_FORMAT_GZIP
+                                                                                  : INFLATE_FORMAT_ZLIB;
+
+    if (!initInflateStream(&stream, format))
+    {
+        free(inputBuffer);
+        if (chunkBuffer)
+            free(chunkBuffer);
+        fclose(file);
+        return FALSE;
+    }
 
-    /* Skip zlib header (2 bytes) and initialize some data */
-    ULONG srcPos = 2;
-    ULONG dstPos = 0;
+    setInflateStreamInput(&stream, inputBuffer, bytesRead);
+    setInflateStreamOutput(&stream, outputBuffer, outputSize);
 
-    /* Handle dictionary if present (4 more bytes to skip) */
-    if (hasDictionary && compressedSize >= 6)
+    for (;;)
     {
-        /* Dictionary ID is 4 bytes */
-        srcPos += 4;
-        fileLoggerAddDebugEntry("Skipping 4-byte dictionary ID");
+        result = inflateStreamProcess(&stream);
+
+        if (result == INFLATE_STREAM_NEED_INPUT)
+        {
+            bytesRead = fread(inputBuffer, 1, ZLIB_FILE_INPUT_SIZE, file);
+            if (bytesRead == 0)
+            {
+                result = finishInflateStreamInput(&stream);
+                break;
+            }
+            setInflateStreamInput(&stream, inputBuffer, bytesRead);
+        }
+        else if (result == INFLATE_STREAM_OUTPUT_FULL && callback)
+        {
+            if (!callback(chunkBuffer, ZLIB_FILE_CHUNK_SIZE, userData))
+            {
+                LOG_DEBUG("File decompression stopped by the output callback");
+                break;
+            }
+            setInflateStreamOutput(&stream, chunkBuffer, ZLIB_FILE_CHUNK_SIZE);
+        }
+        else
+        {
+            break;
+        }
     }
 
-    /* Call the inflate function to decompress the data */
-    if (!inflateData(compressedData, compressedSize, srcPos, *decompressedData,
-                     estimatedSize, decompressedSize))
+    switch (result)
     {
-        fileLoggerAddErrorEntry("DEFLATE decompression failed");
-        free(*decompressedData);
-        *decompressedData = NULL;
-        return FALSE;
+    case INFLATE_STREAM_DONE:
+        /* Hand over whatever is left in the last piece */
+        pending = stream.nextOut - outputBuffer;
+        success = !callback || pending == 0 || callback(chunkBuffer, pending, userData);
+        if (success)
+        {
+            *decompressedSize = stream.totalOut;
+            LOG_DEBUGF(logMessage, "Decompressed %s file %s: %lu bytes",
+                       (format == INFLATE_FORMAT_GZIP) ? "gzip" : "zlib", filename, *decompressedSize);
+        }
+        break;
+
+    case INFLATE_STREAM_OUTPUT_FULL:
+        if (!callback)
+            LOG_ERROR("Output buffer overflow: decompressed file larger than the buffer");
+        break;
+
+    default:
+        logInflateStreamError(&stream);
+        break;
     }
 
-    sprintf(logMessage, "Successful decompression: %lu bytes compressed, %lu bytes decompressed",
-            compressedSize, *decompressedSize);
-    fileLoggerAddDebugEntry(logMessage);
+    endInflateStream(&stream);
+    free(inputBuffer);
+    if (chunkBuffer)
+        free(chunkBuffer);
+    fclose(file);
 
-    /* Verify Adler-32 checksum */
-    if (!verifyAdler32Checksum(compressedData, compressedSize, *decompressedData, *decompressedSize))
+    return success;
+}
+
+/* Decompress a zlib or gzip file into a caller-supplied buffer */
+BOOL decompressZlibFile(CONST_STRPTR filename, UBYTE *outputBuffer, ULONG outputSize, ULONG *decompressedSize)
+{
+    if (!filename || !outputBuffer || !decompressedSize)
     {
-        fileLoggerAddErrorEntry("Adler-32 checksum verification failed");
-        free(*decompressedData);
-        *decompressedData = NULL;
+        LOG_DEBUG("Invalid parameters for zlib file decompression");
         return FALSE;
     }
 
-    // fileLoggerAddDebugEntry("Adler-32 checksum verification successful");
-    return TRUE;
+    return inflateZlibFile(filename, outputBuffer, outputSize, NULL, NULL, decompressedSize);
 }
 
-/* Calculate Adler-32 checksum
- * Implementation based on RFC 1950 specification
- * Adler-32 is a checksum algorithm which is a modified version of Fletcher's checksum
- */
-#define ADLER_MOD 65521 /* Largest prime smaller than 65536 */
-
-ULONG calculateAdler32(UBYTE *data, ULONG length)
+/* Decompress a zlib or gzip file, passing the output to a callback */
+BOOL decompressZlibFileToCallback(CONST_STRPTR filename, ZlibOutputCallback callback, APTR userData,
+                                  ULONG *decompressedSize)
 {
-    ULONG a = 1, b = 0;
-    ULONG i;
-
-    /* Process each byte */
-    for (i = 0; i < length; i++)
+    if (!filename || !callback || !decompressedSize)
     {
-        a = (a + data[i]) % ADLER_MOD;
-        b = (b + a) % ADLER_MOD;
+        LOG_DEBUG("Invalid parameters for zlib file decompression");
+        return FALSE;
     }
 
-    return (b << 16) | a;
+    return inflateZlibFile(filename, NULL, 0, callback, userData, decompressedSize);
 }
 
-/* Verify Adler-32 checksum in ZLIB data
- * According to RFC 1950, the Adler-32 checksum is stored as 4 bytes
- * at the end of the ZLIB stream
- */
-BOOL verifyAdler32Checksum(UBYTE *compressedData, ULONG compressedSize, UBYTE *decompressedData, ULONG decompressedSize)
+/* Compress data into a newly allocated zlib stream
+ * The buffer is sized for the worst case up front and trimmed afterwards */
+BOOL compressZlibData(UBYTE *data, ULONG size, UBYTE level, UBYTE **compressedData, ULONG *compressedSize)
 {
     char logMessage[256];
-    ULONG storedChecksum, calculatedChecksum;
+    UBYTE *outputBuffer;
+    UBYTE *trimmedBuffer;
+    ULONG outputSize;
+
+    /* Validate parameters */
+    if ((!data && size > 0) || !compressedData || !compressedSize)
+    {
+        LOG_DEBUG("Invalid parameters for zlib compression");
+        return FALSE;
+    }
 
-    // fileLoggerAddDebugEntry("Starting Adler-32 checksum verification");
+    *compressedData = NULL;
+    *compressedSize = 0;
 
-    /* Make sure we have at least 4 bytes for the checksum at the end */
-    if (compressedSize < 6) /* 2 header bytes + at least 4 checksum bytes */
+    outputSize = getDeflateBound(size);
+    outputBuffer = (UBYTE *)malloc(outputSize);
+    if (!outputBuffer)
     {
-        sprintf(logMessage, "Compressed data too small to contain checksum: %lu bytes", compressedSize);
-        fileLoggerAddDebugEntry(logMessage);
+        LOG_DEBUG("Failed to allocate memory for compressed data");
         return FALSE;
     }
 
-    /* Log the size of the compressed and decompressed data */
-    sprintf(logMessage, "Compressed size: %lu bytes, Decompressed size: %lu bytes",
-            compressedSize, decompressedSize);
-    fileLoggerAddDebugEntry(logMessage);
+    if (!deflateData(data, size, outputBuffer, outputSize, compressedSize, level, DEFLATE_FORMAT_ZLIB))
+    {
+        LOG_ERROR("zlib compression failed");
+        free(outputBuffer);
+        return FALSE;
+    }
 
-    /* Extract stored checksum (big-endian) from the end of the compressed data */
-    storedChecksum = ((ULONG)compressedData[compressedSize - 4] << 24) |
-                     ((ULONG)compressedData[compressedSize - 3] << 16) |
-                     ((ULONG)compressedData[compressedSize - 2] << 8) |
-                     (ULONG)compressedData[compressedSize - 1];
+    /* Give back the unused tail of the buffer */
+    trimmedBuffer = (UBYTE *)realloc(outputBuffer, *compressedSize);
+    if (trimmedBuffer)
+        outputBuffer = trimmedBuffer;
+    *compressedData = outputBuffer;
 
-    /* Calculate checksum of decompressed data */
-    calculatedChecksum = calculateAdler32(decompressedData, decompressedSize);
+    LOG_DEBUGF(logMessage, "Successful compression: %lu bytes in, %lu bytes compressed", size, *compressedSize);
 
-    // sprintf(logMessage, "Adler-32 checksum: stored=0x%08lX, calculated=0x%08lX",
-    //         storedChecksum, calculatedChecksum);
-    // fileLoggerAddDebugEntry(logMessage);
+    return TRUE;
+}
 
-    /* Compare stored and calculated checksums */
-    if (storedChecksum == calculatedChecksum)
-    {
-        fileLoggerAddDebugEntry("Adler-32 checksum verification passed");
-        return TRUE;
+/* Calculate Adler-32 checksum
+ * Implementation based on RFC 1950 specification
+ * Adler-32 is a checksum algorithm which is a modified version of Fletcher's checksum
+ */
+#define ADLER_MOD 65521 /* Largest prime smaller than 65536 */
+
+/* Largest n such that 255n(n+1)/2 + (n+1)(ADLER_MOD-1) fits in 32 bits:
+ * the sums can run this many bytes before they must be reduced */
+#define ADLER_NMAX 5552
+
+#define ADLER_DO1(buf, i) \
+    {                     \
+        a += (buf)[i];    \
+        b += a;           \
     }
-    else
+#define ADLER_DO4(buf, i) \
+    ADLER_DO1(buf, i);    \
+    ADLER_DO1(buf, i + 1); \
+    ADLER_DO1(buf, i + 2); \
+    ADLER_DO1(buf, i + 3)
+#define ADLER_DO16(buf)  \
+    ADLER_DO4(buf, 0);   \
+    ADLER_DO4(buf, 4);   \
+    ADLER_DO4(buf, 8);   \
+    ADLER_DO4(buf, 12)
+
+/* Update a running Adler-32 checksum with more data
+ * Start from 1 for a new checksum. The modulo is only taken once per
+ * ADLER_NMAX bytes instead of twice per byte, which matters on the 68k
+ * where division is slow */
+ULONG adler32Update(ULONG adler, UBYTE *data, ULONG length)
+{
+    ULONG a = adler & 0xFFFF;
+    ULONG b = adler >> 16;
+    ULONG blockLength;
+
+    while (length > 0)
     {
-        fileLoggerAddErrorEntry("Adler-32 checksum verification failed - checksums don't match");
-        return FALSE;
+        blockLength = length < ADLER_NMAX ? length : ADLER_NMAX;
+        length -= blockLength;
+
+        while (blockLength >= 16)
+        {
+            ADLER_DO16(data);
+            data += 16;
+            blockLength -= 16;
+        }
+
+        while (blockLength--)
+        {
+            a += *data++;
+            b += a;
+        }
+
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
     }
+
+    return (b << 16) | a;
 }
@@ -1,6 +1,6 @@
 /*
  * Basic zlib utilities for AmigaOS 3.1
- * Used for decompressing zlib data in PNG files
+ * Used for decompressing zlib data in PNG files and game data files
  */
 
 #ifndef ZLIBUTILS_H
@@ -8,44 +8,93 @@
 
 #include <exec/types.h>
 
-/* Bit buffer structure for reading bits from a byte stream */
+/* Number of bits peekBits/readBitsWide can return in one call. The
+ * accumulator is refilled a byte at a time until it holds more than this */
+#define BITBUFFER_MAX_BITS 24
+
+/* Bit buffer structure for reading bits from a byte stream
+ * Bits are gathered LSB first into a 32-bit accumulator so callers can
+ * peek at a whole Huffman code and consume it in one step */
 typedef struct BitBuffer
 {
-    UBYTE *data;    /* Pointer to the data buffer */
-    ULONG size;     /* Size of the data buffer in bytes */
-    ULONG pos;      /* Current byte position in the buffer */
-    UBYTE bitPos;   /* Current bit position in the current byte (0-7) */
-    ULONG bitCount; /* Number of bits read so far */
+    UBYTE *data;     /* Pointer to the data buffer */
+    ULONG size;      /* Size of the data buffer in bytes */
+    ULONG pos;       /* Next byte to load into the accumulator */
+    ULONG bitAccum;  /* Bit accumulator, next bit in the LSB */
+    UBYTE bitsAvail; /* Number of valid bits in the accumulator */
+    ULONG bitCount;  /* Number of bits read so far */
 } BitBuffer;
 
-/* Function to decompress zlib-compressed data */
+/* Growable-buffer decompression: first guess is compressedSize times this, at least ZLIB_GROW_MIN_SIZE */
+#define ZLIB_GROW_INITIAL_RATIO 4
+#define ZLIB_GROW_MIN_SIZE 4096
+
+/* Function to decompress zlib-compressed data of unknown size into a newly allocated buffer */
 BOOL decompressZlibData(UBYTE *compressedData, ULONG compressedSize, UBYTE **decompressedData, ULONG *decompressedSize);
 
+/* Function to decompress zlib-compressed data of known size into a caller-supplied buffer */
+BOOL decompressZlibDataToBuffer(UBYTE *compressedData, ULONG compressedSize, UBYTE *outputBuffer, ULONG outputSize,
+                                ULONG *decompressedSize);
+
+/* File decompression reads through an input buffer of this size, so memory
+ * stays bounded whatever the file size; callback output arrives in pieces
+ * of at most ZLIB_FILE_CHUNK_SIZE bytes */
+#define ZLIB_FILE_INPUT_SIZE 4096
+#define ZLIB_FILE_CHUNK_SIZE 16384
+
+/* Receives each piece of decompressed file data; return FALSE to abort */
+typedef BOOL (*ZlibOutputCallback)(UBYTE *data, ULONG length, APTR userData);
+
+/* Function to decompress a zlib (.z) or gzip (.gz) file into a caller-supplied buffer
+ * The format is detected from the first bytes; only the first gzip member is read */
+BOOL decompressZlibFile(CONST_STRPTR filename, UBYTE *outputBuffer, ULONG outputSize, ULONG *decompressedSize);
+
+/* Function to decompress a zlib (.z) or gzip (.gz) file, passing the output to a callback */
+BOOL decompressZlibFileToCallback(CONST_STRPTR filename, ZlibOutputCallback callback, APTR userData,
+                                  ULONG *decompressedSize);
+
+/* Function to compress data into a newly allocated zlib stream at the given DEFLATE_LEVEL_* */
+BOOL compressZlibData(UBYTE *data, ULONG size, UBYTE level, UBYTE **compressedData, ULONG *compressedSize);
+
+/* Preset dictionaries that can be registered at once */
+#define ZLIB_MAX_DICTIONARIES 8
+
+/* Register a preset dictionary for FDICT streams; dictId receives its Adler-32 ID
+ * The data is not copied and must outlive its registration */
+BOOL registerZlibDictionary(const UBYTE *dictionary, ULONG length, ULONG *dictId);
+
+/* Forget a registered preset dictionary */
+void unregisterZlibDictionary(ULONG dictId);
+
+/* Find a registered preset dictionary by its Adler-32 ID */
+BOOL findZlibDictionary(ULONG dictId, const UBYTE **dictionary, ULONG *length);
+
 /* Function to process zlib header */
 BOOL processZlibHeader(UBYTE *compressedData, ULONG compressedSize, UBYTE *compressionMethod, UBYTE *compressionInfo,
                        UBYTE *fCheck, BOOL *hasDictionary, UBYTE *compressionLevel);
 
-/* Function to inflate/decompress DEFLATE compressed data */
-BOOL inflateData(UBYTE *compressedData, ULONG compressedSize, ULONG startPos, UBYTE *outputBuffer,
-                 ULONG outputBufferSize, ULONG *bytesWritten);
+/* Update a running Adler-32 checksum (start from 1) with more data */
+ULONG adler32Update(ULONG adler, UBYTE *data, ULONG length);
 
-/* Function to calculate Adler-32 checksum */
-ULONG calculateAdler32(UBYTE *data, ULONG length);
+/* Initialize a bit buffer for reading compressed data */
+void initBitBuffer(BitBuffer *buffer, UBYTE *data, ULONG size, ULONG startPos);
 
-/* Function to verify Adler-32 checksum in ZLIB data */
-BOOL verifyAdler32Checksum(UBYTE *compressedData, ULONG compressedSize, UBYTE *decompressedData, ULONG decompressedSize);
+/* Top up the accumulator from the byte stream */
+void refillBitBuffer(BitBuffer *buffer);
 
-/* Process an uncompressed (type 0) DEFLATE block */
-BOOL processUncompressedBlock(BitBuffer *bitBuf, UBYTE *compressedData, ULONG compressedSize,
-                              UBYTE *outputBuffer, ULONG outputBufferSize, ULONG *outPos);
+/* Return the next numBits bits (up to BITBUFFER_MAX_BITS) without consuming them.
+ * Bits past the end of the data read as zero */
+ULONG peekBits(BitBuffer *buffer, UBYTE numBits);
 
-/* Skip an unsupported DEFLATE block type */
-BOOL processSkipUnsupportedBlock(BitBuffer *bitBuf, BOOL isFinalBlock, const char *blockTypeName);
+/* Consume numBits bits previously inspected with peekBits */
+BOOL consumeBits(BitBuffer *buffer, UBYTE numBits);
 
-/* Initialize a bit buffer for reading compressed data */
-void initBitBuffer(BitBuffer *buffer, UBYTE *data, ULONG size, ULONG startPos);
+/* Read up to BITBUFFER_MAX_BITS bits from the bit buffer (LSB first) */
+BOOL readBitsWide(BitBuffer *buffer, UBYTE numBits, ULONG *value);
 
-/* Read bits from the bit buffer (LSB first) */
+/* Read up to 8 bits from the bit buffer (LSB first)
+ * The inflater no longer uses it; kept for the bit-at-a-time reference
+ * decoder in the codecbench Huffman benchmark */
 BOOL readBits(BitBuffer *buffer, UBYTE numBits, UBYTE *value);
 
 #endif /* ZLIBUTILS_H */
\ No newline at end of file
@@ -0,0 +1,33 @@
+/*
+ * Shared helpers for the codec benchmarks
+ */
+
+#include <time.h>
+#include <exec/types.h>
+#include "benchutils.h"
+
+/* Simple LCG so runs are repeatable */
+static ULONG benchSeed = 12345;
+
+void seedRandom(ULONG seed)
+{
+    benchSeed = seed;
+}
+
+ULONG nextRandom(void)
+{
+    benchSeed = benchSeed * 1103515245UL + 12345UL;
+    return (benchSeed >> 8) & 0xFFFFFF;
+}
+
+ULONG elapsedMillis(clock_t start)
+{
+    return (ULONG)(((clock() - start) * 1000UL) / CLOCKS_PER_SEC);
+}
+
+/* Single operations can be far shorter than a clock tick, so callers sum
+ * their ticks and convert once at the end */
+ULONG ticksToMillis(clock_t ticks)
+{
+    return (ULONG)((ticks * 1000UL) / CLOCKS_PER_SEC);
+}
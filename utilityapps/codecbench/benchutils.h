@@ -0,0 +1,24 @@
+/*
+ * Shared helpers for the codec benchmarks
+ * Repeatable pseudo-random input and integer millisecond timing
+ */
+
+#ifndef BENCHUTILS_H
+#define BENCHUTILS_H
+
+#include <time.h>
+#include <exec/types.h>
+
+// Restart the random sequence so each benchmark sees the same input on every run
+void seedRandom(ULONG seed);
+
+// Next 24-bit value from the shared LCG
+ULONG nextRandom(void);
+
+// Milliseconds since start, kept integral so no float maths library is needed
+ULONG elapsedMillis(clock_t start);
+
+// Convert a summed clock() tick count to milliseconds
+ULONG ticksToMillis(clock_t ticks);
+
+#endif /* BENCHUTILS_H */
@@ -0,0 +1,75 @@
+/*
+ * Codec Benchmark
+ * Times the PNG/zlib codec kernels used by PaperTanksEditor
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include "../../src/utils/filelogger.h"
+#include "huffmanbench.h"
+#include "crcbench.h"
+#include "fuzzbench.h"
+#include "deflatebench.h"
+
+int main(int argc, char **argv)
+{
+    ULONG numSymbols = 200000; // Default number of symbols to decode
+    ULONG crcBufferKB = 64;    // Default CRC buffer size
+    ULONG fuzzCases = 2000;    // Default number of fuzz corpus cases
+    ULONG deflateKB = 64;      // Default deflate benchmark input size
+
+    // Initialize logger
+    fileLoggerInit("codecbench.log");
+
+    // If a symbol count was provided, use it instead
+    if (argc > 1)
+    {
+        numSymbols = strtoul(argv[1], NULL, 10);
+    }
+
+    // If a CRC buffer size was provided, use it instead
+    if (argc > 2)
+    {
+        crcBufferKB = strtoul(argv[2], NULL, 10);
+    }
+
+    // If a fuzz case count was provided, use it instead
+    if (argc > 3)
+    {
+        fuzzCases = strtoul(argv[3], NULL, 10);
+    }
+
+    // If a deflate input size was provided, use it instead
+    if (argc > 4)
+    {
+        deflateKB = strtoul(argv[4], NULL, 10);
+    }
+
+    if (!runHuffmanBenchmark(numSymbols))
+    {
+        printf("Huffman benchmark failed\n");
+    }
+
+    if (!runCRCBenchmark(crcBufferKB))
+    {
+        printf("CRC benchmark failed\n");
+    }
+
+    if (!runFuzzBenchmark(fuzzCases))
+    {
+        printf("Fuzz benchmark failed\n");
+    }
+
+    if (!runDeflateBenchmark(deflateKB))
+    {
+        printf("Deflate benchmark failed\n");
+    }
+
+    fileLoggerClose();
+
+    return 0;
+}
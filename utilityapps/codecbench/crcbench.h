@@ -0,0 +1,14 @@
+/*
+ * CRC-32 benchmark for AmigaOS 3.1
+ * Measures the throughput of the slice-by-8 CRC-32 kernel
+ */
+
+#ifndef CRCBENCH_H
+#define CRCBENCH_H
+
+#include <exec/types.h>
+
+// Checksum a buffer of bufferKB kilobytes repeatedly and print the throughput in MB/s
+BOOL runCRCBenchmark(ULONG bufferKB);
+
+#endif /* CRCBENCH_H */
@@ -0,0 +1,147 @@
+/*
+ * DEFLATE compressor benchmark for AmigaOS 3.1
+ * Compresses the same input at every level from DEFLATE_LEVEL_NONE to
+ * DEFLATE_LEVEL_BEST, then at DEFLATE_LEVEL_RLE, and reports time, throughput and ratio, so the
+ * levels used for interactive saves and asset packing can be chosen
+ * from real numbers. Every result is inflated again and compared.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include "../../src/utils/deflateutils.h"
+#include "../../src/utils/zlibutils.h"
+#include "benchutils.h"
+#include "deflatebench.h"
+
+/* Repeat short runs until each level has compressed at least this much */
+#define DEFLATE_BENCH_MIN_KB 256
+
+/* Words for the text part of the input (level scripts, config files) */
+static const char *benchWords[] = {
+    "tank", "level", "sprite", "palette", "wall", "spawn", "enemy", "player",
+    "=", "{", "}", ";", "0", "1", "16", "32", "x", "y", "width", "height"};
+
+/* Fill the input: first half like filtered PNG rows (mostly small
+ * deltas with some noise), second half word-based text */
+static void fillBenchInput(UBYTE *buffer, ULONG size)
+{
+    ULONG half = size / 2;
+    ULONG i = 0;
+
+    seedRandom(12345);
+
+    for (i = 0; i < half; i++)
+    {
+        if ((i % 301) == 0)
+            buffer[i] = (UBYTE)(nextRandom() % 5); /* Filter type byte */
+        else if (nextRandom() % 8 == 0)
+            buffer[i] = (UBYTE)nextRandom();
+        else
+            buffer[i] = (UBYTE)((nextRandom() % 5) - 2);
+    }
+
+    while (i < size)
+    {
+        const char *word = benchWords[nextRandom() % (sizeof(benchWords) / sizeof(benchWords[0]))];
+
+        while (*word && i < size)
+            buffer[i++] = (UBYTE)*word++;
+        if (i < size)
+            buffer[i++] = (nextRandom() % 6 == 0) ? '\n' : ' ';
+    }
+}
+
+/* Time one level and check its output inflates back to the input */
+static BOOL benchDeflateLevel(UBYTE level, UBYTE *input, ULONG inputKB, UBYTE *compressed, ULONG bound,
+                              UBYTE *roundTrip, ULONG passes)
+{
+    ULONG inputSize = inputKB * 1024;
+    ULONG compressedSize = 0, outSize, pass;
+    ULONG millis, kbPerSec, ratio;
+    clock_t start;
+
+    start = clock();
+    for (pass = 0; pass < passes; pass++)
+    {
+        if (!deflateData(input, inputSize, compressed, bound, &compressedSize, level, DEFLATE_FORMAT_ZLIB))
+        {
+            printf("  level %u: compression failed\n", level);
+            return FALSE;
+        }
+    }
+    millis = elapsedMillis(start);
+
+    if (!decompressZlibDataToBuffer(compressed, compressedSize, roundTrip, inputSize, &outSize) ||
+        outSize != inputSize || memcmp(roundTrip, input, inputSize) != 0)
+    {
+        printf("  level %u: round trip mismatch\n", level);
+        return FALSE;
+    }
+
+    if (millis == 0)
+        millis = 1;
+    kbPerSec = (inputKB * passes * 1000UL) / millis;
+    ratio = (compressedSize * 1000UL) / inputSize;
+
+    if (level == DEFLATE_LEVEL_RLE)
+        printf("  RLE:     ");
+    else
+        printf("  level %u: ", level);
+    printf("%lu ms, %lu KB/s, %lu bytes (%lu.%lu%%)\n", millis, kbPerSec, compressedSize, ratio / 10, ratio % 10);
+
+    return TRUE;
+}
+
+BOOL runDeflateBenchmark(ULONG inputKB)
+{
+    UBYTE *input, *compressed, *roundTrip;
+    ULONG inputSize, bound, passes;
+    UBYTE level;
+    BOOL success = TRUE;
+
+    if (inputKB == 0)
+        inputKB = 64;
+
+    inputSize = inputKB * 1024;
+    bound = getDeflateBound(inputSize);
+    passes = (inputKB >= DEFLATE_BENCH_MIN_KB) ? 1 : DEFLATE_BENCH_MIN_KB / inputKB;
+
+    input = (UBYTE *)malloc(inputSize);
+    compressed = (UBYTE *)malloc(bound);
+    roundTrip = (UBYTE *)malloc(inputSize);
+    if (!input || !compressed || !roundTrip)
+    {
+        printf("Deflate benchmark: out of memory\n");
+        if (input)
+            free(input);
+        if (compressed)
+            free(compressed);
+        if (roundTrip)
+            free(roundTrip);
+        return FALSE;
+    }
+
+    fillBenchInput(input, inputSize);
+
+    printf("Deflate benchmark: %lu KB input, %lu passes per level\n", inputKB, passes);
+
+    for (level = DEFLATE_LEVEL_NONE; level <= DEFLATE_LEVEL_BEST; level++)
+    {
+        if (!benchDeflateLevel(level, input, inputKB, compressed, bound, roundTrip, passes))
+            success = FALSE;
+    }
+
+    if (!benchDeflateLevel(DEFLATE_LEVEL_RLE, input, inputKB, compressed, bound, roundTrip, passes))
+        success = FALSE;
+
+    free(input);
+    free(compressed);
+    free(roundTrip);
+
+    return success;
+}
@@ -0,0 +1,14 @@
+/*
+ * DEFLATE compressor benchmark for AmigaOS 3.1
+ * Compares compression speed and ratio across levels
+ */
+
+#ifndef DEFLATEBENCH_H
+#define DEFLATEBENCH_H
+
+#include <exec/types.h>
+
+// Compress inputKB kilobytes of editor-like data at every level, print time, KB/s and ratio, and check the round trip
+BOOL runDeflateBenchmark(ULONG inputKB);
+
+#endif /* DEFLATEBENCH_H */
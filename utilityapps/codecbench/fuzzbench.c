@@ -0,0 +1,483 @@
+/*
+ * Inflate fuzz corpus for AmigaOS 3.1
+ * Generates random complete Huffman code length sets and mutated copies,
+ * checks that buildHuffmanTableInto accepts exactly the sets a reference
+ * Kraft sum accepts, then bit-flips a real zlib stream and checks that
+ * every mutant ends cleanly. Valid tables and the unmodified stream are
+ * timed alongside the rejects so validation cost on good data stays visible.
+ * Finally, PNGs with a rejected IHDR followed by image data are loaded to
+ * check that the loader fails them instead of decoding into a bad buffer,
+ * and probePNG is run on chunks cut off at the end of its read
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include "../../src/utils/zlibutils.h"
+#include "../../src/utils/huffmanUtils.h"
+#include "../../src/utils/inflatestream.h"
+#include "../../src/utils/deflateutils.h"
+#include "../../src/utils/crc32utils.h"
+#include "../../src/graphics/imgpngutils.h"
+#include "benchutils.h"
+#include "fuzzbench.h"
+
+/* zlib level 9 of a 32x32 four-colour RGBA sprite with PNG filter bytes:
+ * one dynamic Huffman block that inflates to FUZZ_SAMPLE_SIZE bytes */
+#define FUZZ_SAMPLE_SIZE 4128
+
+static const UBYTE fuzzSample[] = {
+    0x78, 0xda, 0xed, 0x56, 0xc1, 0x0d, 0xc0, 0x20, 0x08, 0x84, 0x45, 0x7c,
+    0x3b, 0x44, 0x87, 0xed, 0x38, 0x0e, 0xd1, 0x5d, 0xac, 0x36, 0xc5, 0xa8,
+    0x11, 0x7c, 0x19, 0x4c, 0xe4, 0x71, 0x09, 0xc6, 0xc7, 0x71, 0x5c, 0x8e,
+    0x00, 0xc1, 0x7b, 0x90, 0xe0, 0x6f, 0x19, 0xce, 0x39, 0x11, 0x4f, 0xb8,
+    0x44, 0xe0, 0x4f, 0x14, 0x19, 0x64, 0x92, 0xc8, 0xe0, 0xfb, 0x4b, 0x24,
+    0x23, 0x00, 0xd5, 0x89, 0xa4, 0x07, 0xd4, 0x6f, 0xf5, 0x06, 0xe0, 0xf8,
+    0x09, 0x98, 0x05, 0xa8, 0x1e, 0x43, 0x52, 0xc2, 0xa9, 0x64, 0x14, 0x16,
+    0x95, 0x03, 0x85, 0x8d, 0xca, 0xd1, 0x54, 0xeb, 0x37, 0x68, 0x37, 0x80,
+    0xc7, 0x37, 0x60, 0x16, 0xe0, 0xea, 0x98, 0xcd, 0x62, 0xae, 0x6f, 0x41,
+    0xbd, 0xb5, 0x46, 0x24, 0x0c, 0x41, 0x21, 0xe1, 0x36, 0x28, 0xd5, 0xdc,
+    0x06, 0x25, 0xa8, 0x37, 0x00, 0xc7, 0x4f, 0x60, 0x1b, 0x0b, 0x96, 0xc5,
+    0x6c, 0x16, 0x73, 0xb3, 0x00, 0xfa, 0x0b, 0xa5, 0x27, 0x91, 0xae, 0x25,
+    0x86, 0xa0, 0x21, 0x91, 0xae, 0xa5, 0x0c, 0x3c, 0xbe, 0x81, 0x6d, 0x2c,
+    0x58, 0x16, 0xb3, 0x59, 0xcc, 0xcd, 0x02, 0xf5, 0x09, 0xbc, 0x1e, 0xe2,
+    0x18, 0xa6
+};
+
+/* Times the unmodified sample is decoded for the throughput figure */
+#define FUZZ_SAMPLE_RUNS 200
+
+/* Random complete code: keep splitting a random leaf into two children
+ * one bit longer until there are numUsed leaves, then scatter them over
+ * the alphabet */
+static void generateCompleteLengths(UBYTE *lengths, ULONG numCodes, ULONG numUsed, UBYTE maxBits)
+{
+    UBYTE leaves[MAX_LITERAL_CODES];
+    ULONG numLeaves = 2;
+    ULONG i, pick;
+
+    leaves[0] = 1;
+    leaves[1] = 1;
+    while (numLeaves < numUsed)
+    {
+        pick = nextRandom() % numLeaves;
+        if (leaves[pick] >= maxBits)
+            continue;
+        leaves[pick]++;
+        leaves[numLeaves++] = leaves[pick];
+    }
+
+    memset(lengths, 0, numCodes);
+    for (i = 0; i < numLeaves; i++)
+    {
+        do
+            pick = nextRandom() % numCodes;
+        while (lengths[pick] != 0);
+        lengths[pick] = leaves[i];
+    }
+}
+
+/* Reference check: the Kraft sum over all codes must be exactly one,
+ * unless at most one code is used */
+static BOOL referenceAccepts(const UBYTE *lengths, ULONG numCodes)
+{
+    ULONG sum = 0, used = 0, i;
+
+    for (i = 0; i < numCodes; i++)
+    {
+        if (lengths[i] == 0)
+            continue;
+        sum += 1UL << (MAX_BITS - lengths[i]);
+        used++;
+    }
+
+    return used <= 1 || sum == (1UL << MAX_BITS);
+}
+
+/* Build every valid set of the corpus and a mutated copy of each,
+ * comparing the builder's verdict with the reference */
+static BOOL runCodeLengthCorpus(ULONG numSets)
+{
+    static const UWORD alphabetSizes[3] = {MAX_LITERAL_CODES, MAX_DISTANCE_CODES, MAX_CODE_LENGTHS};
+    static const UBYTE alphabetBits[3] = {MAX_BITS, MAX_BITS, 7};
+    static HuffmanEntry storage[INFLATE_LITERAL_TABLE_ENTRIES];
+    UBYTE lengths[MAX_LITERAL_CODES];
+    UBYTE mutant[MAX_LITERAL_CODES];
+    HuffmanTable table;
+    clock_t validTicks = 0, mutantTicks = 0;
+    ULONG rejected = 0, oversubscribed = 0, incomplete = 0;
+    ULONG i, symbol;
+    clock_t start;
+
+    for (i = 0; i < numSets; i++)
+    {
+        ULONG numCodes = alphabetSizes[i % 3];
+        UBYTE maxBits = alphabetBits[i % 3];
+        BOOL built;
+
+        generateCompleteLengths(lengths, numCodes, 2 + nextRandom() % (numCodes - 1), maxBits);
+
+        /* Change one symbol's length; most such sets break the Kraft sum */
+        memcpy(mutant, lengths, numCodes);
+        symbol = nextRandom() % numCodes;
+        do
+            mutant[symbol] = nextRandom() % (maxBits + 1);
+        while (mutant[symbol] == lengths[symbol]);
+
+        start = clock();
+        built = buildHuffmanTableInto(lengths, numCodes, &table, storage, INFLATE_LITERAL_TABLE_ENTRIES);
+        validTicks += clock() - start;
+        if (!built)
+        {
+            printf("Valid code length set %lu was rejected\n", i);
+            return FALSE;
+        }
+
+        start = clock();
+        built = buildHuffmanTableInto(mutant, numCodes, &table, storage, INFLATE_LITERAL_TABLE_ENTRIES);
+        mutantTicks += clock() - start;
+        if (built != referenceAccepts(mutant, numCodes))
+        {
+            printf("Mutated code length set %lu: builder %s, reference %s\n", i,
+                   built ? "accepted" : "rejected", built ? "rejects" : "accepts");
+            return FALSE;
+        }
+
+        if (!built)
+        {
+            rejected++;
+            if (table.status == HUFFMAN_CODES_OVERSUBSCRIBED)
+                oversubscribed++;
+            else if (table.status == HUFFMAN_CODES_INCOMPLETE)
+                incomplete++;
+        }
+    }
+
+    printf("  code length sets: %lu valid built in %lu ms\n", numSets, ticksToMillis(validTicks));
+    printf("  mutated sets:     %lu rejected (%lu over-subscribed, %lu incomplete) in %lu ms\n",
+           rejected, oversubscribed, incomplete, ticksToMillis(mutantTicks));
+
+    return TRUE;
+}
+
+/* Decode one stream into a scratch buffer; mutants may end early or
+ * overflow, but must never run outside their buffers */
+static ULONG inflateSample(InflateStream *stream, UBYTE *data, ULONG size, UBYTE *output, ULONG outputSize)
+{
+    ULONG result;
+
+    resetInflateStream(stream, INFLATE_FORMAT_ZLIB);
+    setInflateStreamInput(stream, data, size);
+    setInflateStreamOutput(stream, output, outputSize);
+
+    result = inflateStreamProcess(stream);
+    if (result == INFLATE_STREAM_NEED_INPUT)
+        result = finishInflateStreamInput(stream);
+
+    return result;
+}
+
+/* Flip one to three random bits of the sample numMutants times and
+ * tally how each mutant ends */
+static BOOL runStreamCorpus(ULONG numMutants)
+{
+    ULONG errorCounts[INFLATE_ERROR_MAX + 1];
+    UBYTE mutant[sizeof(fuzzSample)];
+    UBYTE *output;
+    InflateStream stream;
+    ULONG decoded = 0, overflowed = 0;
+    ULONG sampleTime, mutantTime;
+    ULONG i, flips, result;
+    UBYTE error;
+    clock_t start;
+
+    output = (UBYTE *)malloc(FUZZ_SAMPLE_SIZE * 2);
+    if (!output || !initInflateStream(&stream, INFLATE_FORMAT_ZLIB))
+    {
+        printf("Fuzz benchmark: out of memory\n");
+        free(output);
+        return FALSE;
+    }
+
+    memset(errorCounts, 0, sizeof(errorCounts));
+
+    start = clock();
+    for (i = 0; i < FUZZ_SAMPLE_RUNS; i++)
+    {
+        result = inflateSample(&stream, (UBYTE *)fuzzSample, sizeof(fuzzSample), output, FUZZ_SAMPLE_SIZE * 2);
+        if (result != INFLATE_STREAM_DONE || stream.totalOut != FUZZ_SAMPLE_SIZE)
+        {
+            printf("Unmodified sample failed to inflate\n");
+            endInflateStream(&stream);
+            free(output);
+            return FALSE;
+        }
+    }
+    sampleTime = elapsedMillis(start);
+
+    start = clock();
+    for (i = 0; i < numMutants; i++)
+    {
+        memcpy(mutant, fuzzSample, sizeof(fuzzSample));
+        for (flips = 1 + nextRandom() % 3; flips > 0; flips--)
+        {
+            ULONG bit = nextRandom() % (sizeof(fuzzSample) * 8);
+            mutant[bit >> 3] ^= 1 << (bit & 7);
+        }
+
+        result = inflateSample(&stream, mutant, sizeof(mutant), output, FUZZ_SAMPLE_SIZE * 2);
+        if (result == INFLATE_STREAM_DONE)
+        {
+            decoded++;
+        }
+        else if (result == INFLATE_STREAM_OUTPUT_FULL)
+        {
+            overflowed++;
+        }
+        else
+        {
+            error = getInflateStreamError(&stream, NULL);
+            if (error > INFLATE_ERROR_MAX || error == INFLATE_ERROR_NONE)
+            {
+                printf("Mutant %lu failed without an error code\n", i);
+                endInflateStream(&stream);
+                free(output);
+                return FALSE;
+            }
+            errorCounts[error]++;
+        }
+    }
+    mutantTime = elapsedMillis(start);
+
+    endInflateStream(&stream);
+    free(output);
+
+    printf("  sample stream:    %d x %lu bytes inflated in %lu ms\n", FUZZ_SAMPLE_RUNS, (ULONG)FUZZ_SAMPLE_SIZE, sampleTime);
+    printf("  mutated streams:  %lu in %lu ms, %lu still decoded, %lu overflowed\n",
+           numMutants, mutantTime, decoded, overflowed);
+    for (error = INFLATE_ERROR_TRUNCATED; error <= INFLATE_ERROR_MAX; error++)
+    {
+        if (errorCounts[error] > 0)
+            printf("    %-28s %lu\n", getInflateErrorName(error), errorCounts[error]);
+    }
+
+    return TRUE;
+}
+
+/* Size of the black 8-bit RGB test PNG */
+#define FUZZ_PNG_WIDTH 64
+#define FUZZ_PNG_HEIGHT 64
+
+/* Offset of the IHDR data in a PNG file, after the signature and chunk header */
+#define FUZZ_PNG_IHDR_DATA 16
+
+/* tEXt chunks for the probePNG cases */
+#define FUZZ_CHUNK_TEXT 0x74455874
+
+/* Scratch file for the probePNG cases, which read from disk */
+#define FUZZ_PROBE_FILE "T:codecbench_probe.png"
+
+/* One malformed IHDR: a single byte of the IHDR data replaced */
+typedef struct
+{
+    const char *name;
+    UBYTE offset;
+    UBYTE value;
+} PNGHeaderCase;
+
+static const PNGHeaderCase pngHeaderCases[] = {
+    {"zero width", 3, 0},
+    {"zero height", 7, 0},
+    {"oversized width", 0, 0x7F},
+    {"oversized height", 4, 0x7F},
+    {"4-bit RGB", 8, 4},
+    {"colour type 5", 9, 5},
+    {"compression method 1", 10, 1},
+    {"filter method 1", 11, 1},
+    {"interlace method 2", 12, 2},
+    {"interlace method 34", 12, 34},
+    {"interlace method 189", 12, 189}};
+
+static void putFuzzLong(UBYTE *buffer, ULONG value)
+{
+    buffer[0] = (UBYTE)(value >> 24);
+    buffer[1] = (UBYTE)(value >> 16);
+    buffer[2] = (UBYTE)(value >> 8);
+    buffer[3] = (UBYTE)value;
+}
+
+/* Write a chunk whose data is already in place after its 8-byte header
+ * Returns the size of the whole chunk */
+static ULONG sealFuzzChunk(UBYTE *chunk, ULONG type, ULONG length)
+{
+    putFuzzLong(chunk, length);
+    putFuzzLong(chunk + 4, type);
+    putFuzzLong(chunk + 8 + length, crc32Update(0, chunk + 4, 4 + length));
+    return 12 + length;
+}
+
+/* Write a PNG to the scratch file and probe it */
+static BOOL probeFuzzPNG(UBYTE *data, ULONG size, PNGInfo *info)
+{
+    BPTR file;
+    LONG written;
+    BOOL probed;
+
+    file = Open(FUZZ_PROBE_FILE, MODE_NEWFILE);
+    if (!file)
+        return FALSE;
+
+    written = Write(file, data, size);
+    Close(file);
+
+    probed = (written == (LONG)size) && probePNG(FUZZ_PROBE_FILE, info);
+    DeleteFile(FUZZ_PROBE_FILE);
+
+    return probed;
+}
+
+/* Probe files whose chunk after IHDR is cut off inside its CRC, ends
+ * exactly at PNG_PROBE_READ_SIZE, or has its CRC straddle it; the walk
+ * must stop inside its buffer and still report the IHDR */
+static BOOL runPNGProbeCases(UBYTE *png, UBYTE *scratch)
+{
+    static const UWORD textLengths[3] = {100, PNG_PROBE_READ_SIZE - 33 - 12, PNG_PROBE_READ_SIZE - 33 - 10};
+    PNGInfo info;
+    ULONG size, i;
+
+    for (i = 0; i < 3; i++)
+    {
+        /* Signature and IHDR, then a tEXt chunk */
+        memcpy(scratch, png, 33);
+        memset(scratch + 33 + 8, 'x', textLengths[i]);
+        size = 33 + sealFuzzChunk(scratch + 33, FUZZ_CHUNK_TEXT, textLengths[i]);
+
+        /* The first file ends two bytes into the tEXt CRC, the others go on to an IDAT */
+        if (i == 0)
+            size -= 2;
+        else
+            size += sealFuzzChunk(scratch + size, PNG_CHUNK_IDAT, 0);
+
+        if (!probeFuzzPNG(scratch, size, &info) ||
+            info.width != FUZZ_PNG_WIDTH || info.height != FUZZ_PNG_HEIGHT)
+        {
+            printf("probePNG failed with a %u-byte tEXt chunk\n", textLengths[i]);
+            return FALSE;
+        }
+    }
+
+    printf("  PNG probes:       %lu chunk boundary cases probed\n", i);
+
+    return TRUE;
+}
+
+/* Build a valid PNG, then load it with each malformed IHDR in turn; the
+ * IHDR CRC is recomputed so only the header fields are wrong */
+static BOOL runPNGHeaderCorpus(void)
+{
+    static const UBYTE signature[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
+    ULONG rawSize = FUZZ_PNG_HEIGHT * (1 + FUZZ_PNG_WIDTH * 3);
+    UBYTE *raw, *png, *mutant, *image;
+    ULONG idatSize, pngSize, i;
+    BOOL loaded;
+
+    raw = (UBYTE *)calloc(rawSize, 1);
+    png = (UBYTE *)malloc(8 + 25 + 12 + getDeflateBound(rawSize) + 12);
+    mutant = png ? (UBYTE *)malloc(8 + 25 + 12 + getDeflateBound(rawSize) + 12) : NULL;
+    if (!raw || !png || !mutant)
+    {
+        printf("PNG header corpus: out of memory\n");
+        free(raw);
+        free(png);
+        free(mutant);
+        return FALSE;
+    }
+
+    /* Signature, IHDR for a 64x64 8-bit RGB image, one IDAT of black rows, IEND */
+    memcpy(png, signature, 8);
+    pngSize = 8;
+    putFuzzLong(png + pngSize + 8, FUZZ_PNG_WIDTH);
+    putFuzzLong(png + pngSize + 12, FUZZ_PNG_HEIGHT);
+    png[pngSize + 16] = 8;
+    png[pngSize + 17] = PNG_COLOR_TYPE_RGB;
+    png[pngSize + 18] = 0;
+    png[pngSize + 19] = 0;
+    png[pngSize + 20] = 0;
+    pngSize += sealFuzzChunk(png + pngSize, PNG_CHUNK_IHDR, 13);
+
+    if (!deflateData(raw, rawSize, png + pngSize + 8, getDeflateBound(rawSize), &idatSize,
+                     DEFLATE_LEVEL_DEFAULT, DEFLATE_FORMAT_ZLIB))
+    {
+        printf("PNG header corpus: failed to compress image data\n");
+        free(raw);
+        free(png);
+        free(mutant);
+        return FALSE;
+    }
+    pngSize += sealFuzzChunk(png + pngSize, PNG_CHUNK_IDAT, idatSize);
+    pngSize += sealFuzzChunk(png + pngSize, PNG_CHUNK_IEND, 0);
+    free(raw);
+
+    setPNGCrcVerification(TRUE);
+
+    image = NULL;
+    loaded = loadPNGFromMemory(png, pngSize, &image, NULL);
+    free(image);
+    if (!loaded)
+    {
+        printf("Unmodified test PNG failed to load\n");
+        setPNGCrcVerification(FALSE);
+        free(png);
+        free(mutant);
+        return FALSE;
+    }
+
+    for (i = 0; i < sizeof(pngHeaderCases) / sizeof(pngHeaderCases[0]); i++)
+    {
+        memcpy(mutant, png, pngSize);
+        mutant[FUZZ_PNG_IHDR_DATA + pngHeaderCases[i].offset] = pngHeaderCases[i].value;
+        sealFuzzChunk(mutant + 8, PNG_CHUNK_IHDR, 13);
+
+        image = NULL;
+        loaded = loadPNGFromMemory(mutant, pngSize, &image, NULL);
+        if (loaded || image)
+        {
+            printf("PNG with %s was accepted\n", pngHeaderCases[i].name);
+            free(image);
+            setPNGCrcVerification(FALSE);
+            free(png);
+            free(mutant);
+            return FALSE;
+        }
+    }
+
+    setPNGCrcVerification(FALSE);
+    freePNGDecoder();
+
+    printf("  PNG headers:      %lu malformed IHDRs rejected\n", i);
+
+    loaded = runPNGProbeCases(png, mutant);
+    free(png);
+    free(mutant);
+
+    return loaded;
+}
+
+// Run numCases code length sets and numCases stream mutants through the decoder and print the outcome
+BOOL runFuzzBenchmark(ULONG numCases)
+{
+    printf("Inflate fuzz corpus: %lu cases\n", numCases);
+    seedRandom(4242);
+
+    if (!runCodeLengthCorpus(numCases))
+        return FALSE;
+
+    if (!runStreamCorpus(numCases))
+        return FALSE;
+
+    return runPNGHeaderCorpus();
+}
@@ -0,0 +1,16 @@
+/*
+ * Inflate fuzz corpus for AmigaOS 3.1
+ * Feeds random and corrupted Huffman code sets and zlib streams to the
+ * decoder and times the valid cases next to the rejects, then checks that
+ * PNGs with a malformed IHDR are rejected and truncated chunks probe safely
+ */
+
+#ifndef FUZZBENCH_H
+#define FUZZBENCH_H
+
+#include <exec/types.h>
+
+// Run numCases code length sets and numCases stream mutants through the decoder and print the outcome
+BOOL runFuzzBenchmark(ULONG numCases);
+
+#endif /* FUZZBENCH_H */
@@ -0,0 +1,287 @@
+/*
+ * Huffman decoder benchmark for AmigaOS 3.1
+ * Encodes a stream of literal/length symbols with a realistic dynamic code
+ * (lengths 1-15 bits) and times decodeHuffmanValue against a copy of the
+ * original decoder, which read one bit at a time and scanned every code
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <exec/types.h>
+#include <proto/exec.h>
+#include <proto/dos.h>
+#include "../../src/utils/zlibutils.h"
+#include "../../src/utils/huffmanUtils.h"
+#include "benchutils.h"
+#include "huffmanbench.h"
+
+/* Build length-limited Huffman code lengths for the given frequencies.
+ * Plain O(n^2) merging is fine for a 286 symbol alphabet; if a code ends
+ * up longer than MAX_BITS the frequencies are flattened and we retry */
+static void buildCodeLengths(ULONG *freq, ULONG numCodes, UBYTE *lengths)
+{
+    ULONG weight[2 * MAX_LITERAL_CODES];
+    WORD parent[2 * MAX_LITERAL_CODES];
+    BOOL active[2 * MAX_LITERAL_CODES];
+    ULONG i, numNodes, maxLen;
+
+    for (;;)
+    {
+        for (i = 0; i < numCodes; i++)
+        {
+            weight[i] = freq[i];
+            parent[i] = -1;
+            active[i] = TRUE;
+        }
+        numNodes = numCodes;
+
+        /* Merge the two lightest active nodes until one remains */
+        for (;;)
+        {
+            LONG a = -1, b = -1;
+
+            for (i = 0; i < numNodes; i++)
+            {
+                if (!active[i])
+                    continue;
+                if (a < 0 || weight[i] < weight[a])
+                {
+                    b = a;
+                    a = i;
+                }
+                else if (b < 0 || weight[i] < weight[b])
+                {
+                    b = i;
+                }
+            }
+
+            if (b < 0)
+                break;
+
+            weight[numNodes] = weight[a] + weight[b];
+            parent[numNodes] = -1;
+            active[numNodes] = TRUE;
+            active[a] = FALSE;
+            active[b] = FALSE;
+            parent[a] = numNodes;
+            parent[b] = numNodes;
+            numNodes++;
+        }
+
+        maxLen = 0;
+        for (i = 0; i < numCodes; i++)
+        {
+            ULONG len = 0;
+            WORD node = i;
+
+            while (parent[node] >= 0)
+            {
+                node = parent[node];
+                len++;
+            }
+
+            lengths[i] = len;
+            if (len > maxLen)
+                maxLen = len;
+        }
+
+        if (maxLen <= MAX_BITS)
+            return;
+
+        for (i = 0; i < numCodes; i++)
+            freq[i] = (freq[i] >> 1) + 1;
+    }
+}
+
+/* Old decoder: canonical code per symbol, matched by linear search */
+typedef struct LegacyNode
+{
+    UWORD value;
+    UBYTE bits;
+    ULONG code;
+} LegacyNode;
+
+static void buildLegacyNodes(UBYTE *lengths, ULONG numCodes, LegacyNode *nodes, ULONG *codes)
+{
+    ULONG blCount[MAX_BITS + 1];
+    ULONG nextCode[MAX_BITS + 1];
+    ULONG i, code = 0;
+
+    memset(blCount, 0, sizeof(blCount));
+    for (i = 0; i < numCodes; i++)
+        blCount[lengths[i]]++;
+    blCount[0] = 0;
+
+    nextCode[0] = 0;
+    for (i = 1; i <= MAX_BITS; i++)
+    {
+        code = (code + blCount[i - 1]) << 1;
+        nextCode[i] = code;
+    }
+
+    for (i = 0; i < numCodes; i++)
+    {
+        nodes[i].value = i;
+        nodes[i].bits = lengths[i];
+        nodes[i].code = lengths[i] ? nextCode[lengths[i]]++ : 0;
+        codes[i] = nodes[i].code;
+    }
+}
+
+static BOOL legacyDecodeHuffmanValue(BitBuffer *bitBuf, LegacyNode *nodes, ULONG numCodes, UWORD *value)
+{
+    ULONG code = 0;
+    UBYTE len = 0;
+    ULONG i;
+    UBYTE bit;
+
+    while (len <= MAX_BITS)
+    {
+        if (!readBits(bitBuf, 1, &bit))
+            return FALSE;
+
+        code = (code << 1) | bit;
+        len++;
+
+        for (i = 0; i < numCodes; i++)
+        {
+            if (nodes[i].bits == len && nodes[i].code == code)
+            {
+                *value = nodes[i].value;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/* Append a canonical code to the stream, MSB of the code first */
+static void putCode(UBYTE *stream, ULONG *bitPos, ULONG code, UBYTE len)
+{
+    while (len--)
+    {
+        if ((code >> len) & 1)
+            stream[*bitPos >> 3] |= 1 << (*bitPos & 7);
+        (*bitPos)++;
+    }
+}
+
+// Decode numSymbols random literal/length symbols with both decoders and print the timings
+BOOL runHuffmanBenchmark(ULONG numSymbols)
+{
+    ULONG freq[MAX_LITERAL_CODES];
+    UBYTE lengths[MAX_LITERAL_CODES];
+    ULONG codes[MAX_LITERAL_CODES];
+    LegacyNode nodes[MAX_LITERAL_CODES];
+    ULONG cumulative[MAX_LITERAL_CODES];
+    HuffmanTable table;
+    BitBuffer bitBuf;
+    UWORD *symbols = NULL;
+    UBYTE *stream = NULL;
+    ULONG streamSize, bitPos = 0, total = 0;
+    ULONG i, maxLen = 0;
+    clock_t start;
+    ULONG legacyTime, tableTime;
+    BOOL success = FALSE;
+
+    /* Skewed literal distribution similar to flat colour sprite data */
+    for (i = 0; i < MAX_LITERAL_CODES; i++)
+    {
+        if (i < 256)
+            freq[i] = 1 + 40000 / (1 + (i % 48) * (i % 48));
+        else
+            freq[i] = 1 + 4000 / (1 + (i - 256) * 4);
+    }
+
+    buildCodeLengths(freq, MAX_LITERAL_CODES, lengths);
+    buildLegacyNodes(lengths, MAX_LITERAL_CODES, nodes, codes);
+
+    for (i = 0; i < MAX_LITERAL_CODES; i++)
+    {
+        total += freq[i];
+        cumulative[i] = total;
+        if (lengths[i] > maxLen)
+            maxLen = lengths[i];
+    }
+
+    symbols = (UWORD *)malloc(numSymbols * sizeof(UWORD));
+    streamSize = (numSymbols * MAX_BITS + 7) / 8 + 4;
+    stream = (UBYTE *)malloc(streamSize);
+    if (!symbols || !stream)
+    {
+        printf("Huffman benchmark: out of memory\n");
+        goto cleanup;
+    }
+    memset(stream, 0, streamSize);
+
+    /* Encode a random symbol stream with the same distribution */
+    seedRandom(12345);
+    for (i = 0; i < numSymbols; i++)
+    {
+        ULONG pick = nextRandom() % total;
+        ULONG s = 0;
+
+        while (cumulative[s] <= pick)
+            s++;
+
+        symbols[i] = s;
+        putCode(stream, &bitPos, codes[s], lengths[s]);
+    }
+
+    printf("Huffman benchmark: %lu symbols, %lu bytes, longest code %lu bits\n",
+           numSymbols, (bitPos + 7) / 8, maxLen);
+
+    /* Old bit-by-bit linear search */
+    initBitBuffer(&bitBuf, stream, (bitPos + 7) / 8, 0);
+    start = clock();
+    for (i = 0; i < numSymbols; i++)
+    {
+        UWORD value;
+        if (!legacyDecodeHuffmanValue(&bitBuf, nodes, MAX_LITERAL_CODES, &value) || value != symbols[i])
+        {
+            printf("Legacy decoder mismatch at symbol %lu\n", i);
+            goto cleanup;
+        }
+    }
+    legacyTime = elapsedMillis(start);
+
+    /* Table-driven decoder */
+    if (!buildHuffmanTreeFromCodeLengths(lengths, MAX_LITERAL_CODES, &table))
+    {
+        printf("Failed to build Huffman lookup table\n");
+        goto cleanup;
+    }
+
+    initBitBuffer(&bitBuf, stream, (bitPos + 7) / 8, 0);
+    start = clock();
+    for (i = 0; i < numSymbols; i++)
+    {
+        UWORD value;
+        if (!decodeHuffmanValue(&bitBuf, &table, &value) || value != symbols[i])
+        {
+            printf("Table decoder mismatch at symbol %lu\n", i);
+            freeHuffmanTable(&table);
+            goto cleanup;
+        }
+    }
+    tableTime = elapsedMillis(start);
+
+    printf("  lookup table: %lu entries (%lu bytes)\n", (ULONG)table.numEntries,
+           (ULONG)(table.numEntries * sizeof(HuffmanEntry)));
+    freeHuffmanTable(&table);
+
+    printf("  bit-by-bit search: %lu ms\n", legacyTime);
+    printf("  table lookup:      %lu ms\n", tableTime);
+    if (tableTime > 0)
+        printf("  speedup:           %lu.%lux\n", legacyTime / tableTime, (legacyTime * 10 / tableTime) % 10);
+
+    success = TRUE;
+
+cleanup:
+    free(symbols);
+    free(stream);
+    return success;
+}
@@ -0,0 +1,14 @@
+/*
+ * Huffman decoder benchmark for AmigaOS 3.1
+ * Compares the table-driven decoder against the old bit-by-bit search
+ */
+
+#ifndef HUFFMANBENCH_H
+#define HUFFMANBENCH_H
+
+#include <exec/types.h>
+
+// Decode numSymbols random literal/length symbols with both decoders and print the timings
+BOOL runHuffmanBenchmark(ULONG numSymbols);
+
+#endif /* HUFFMANBENCH_H */